@@ -7,14 +7,26 @@
 # define MANDEL_WINDOW_HEIGHT 400
 # define MANDEL_WINDOW_TITLE "Mandelbrot"
 # define MANDEL_ITERATIONS 50
-
-static ControlPoint g_theme[] = {
-	{0.0,    {0x00, 0x0F, 0x64} },
-	{0.16,   {0x20, 0x6B, 0xCB} },
-	{0.42,   {0xED, 0xFF, 0xFF} },
-	{0.6425, {0xFF, 0xAA, 0x00} },
-	{1.0,    {0x00, 0x02, 0x00} },
-	// {0.8575, {0x00, 0x02, 0x00} },
-};
+# define MANDEL_TILE_SIZE 64
+# define MANDEL_SUBDIVIDE_MIN 6
+# define MANDEL_PERIOD_TOLERANCE 1e-12
+# define MANDEL_ESCAPE_UNROLL 8
+# define MANDEL_INTERLEAVE_PIXELS 1024
+# define MANDEL_INTERLEAVE_ITERATIONS 1000
+# define MANDEL_INTERLEAVE_RUNS 3
+# define MANDEL_BENCHMARK_RUNS 3
+// a number type is used while 2 epsilon * margin * iterations <= pixel
+# define MANDEL_PRECISION_MARGIN 256.0
+# define MANDEL_SERIES_TOLERANCE 1e-8
+# define MANDEL_ORBIT_GUARD_BITS 64
+# define MANDEL_HUGE_PAGE_SIZE (2 << 20)
+# define MANDEL_ORBIT_CACHE_ALIGN 4096
+# define MANDEL_ORBIT_CACHE_LIMIT ((size_t)1 << 30)
+# define MANDEL_FLOATEXP_EXPONENT -960
+# define MANDEL_GLITCH_TOLERANCE 1e-3
+# define MANDEL_GLITCH_REFERENCES 64
+# define MANDEL_REFERENCE_PROBES 8
+# define MANDEL_BLA_EPSILON 0x1p-53
+# define MANDEL_BLA_LEVELS_MAX 24
 
 #endif
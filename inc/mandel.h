@@ -4,12 +4,22 @@
 # include <stdio.h>
 # include <stdlib.h>
 # include <stdbool.h>
+# include <string.h>
+# include <limits.h>
 # include <math.h>
 # include <GL/glew.h>
 # include <SDL2/SDL.h>
+# include <pthread.h>
 
 # include <assert.h>
 
+# if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#  define MANDEL_X86
+# endif
+
+# define MAX(x, y) (x > y ? x : y)
+# define MIN(x, y) (x < y ? x : y)
+
 #define SDL_CALL(x) do {                     \
 	SDL_ClearError();                        \
 	x;                                       \
@@ -36,6 +46,40 @@ enum
 	KEY_ZOOM_OUT,
 };
 
+/*
+** Number type of the escape count, PRECISION_AUTO picks the cheapest
+** accurate one from the zoom, see precision.c
+*/
+
+enum
+{
+	PRECISION_DOUBLE = 0,
+	PRECISION_DOUBLE_DOUBLE,
+	PRECISION_PERTURBATION,
+	PRECISION_FLOAT,
+	PRECISION_FIXED64,
+	PRECISION_FIXED128,
+	PRECISION_AUTO,
+};
+
+/*
+** How a pixel of a perturbation render got its count, see glitch.c
+*/
+
+enum
+{
+	PIXEL_COMPUTED = 0,
+	PIXEL_FILLED,
+	PIXEL_GLITCHED,
+};
+
+enum
+{
+	RENDER_BRUTE = 0,
+	RENDER_SUBDIVIDE,
+	RENDER_TRACE,
+};
+
 typedef struct
 {
 	uint8_t 	r;
@@ -62,6 +106,215 @@ typedef struct
 	Color	color;
 }			ControlPoint;
 
+/*
+** mantissa * 2^exponent, see floatexp.c
+*/
+
+typedef struct
+{
+	double			mantissa;
+	int				exponent;
+}					FloatExp;
+
+/*
+** Unevaluated sum hi + lo, see double_double.c
+*/
+
+typedef struct
+{
+	double			hi;
+	double			lo;
+}					DoubleDouble;
+
+/*
+** Q4.124 two's complement fixed point, hi is a Q4.60, see fixed.c
+*/
+
+typedef struct
+{
+	int64_t			hi;
+	uint64_t		lo;
+}					Fixed128;
+
+/*
+** One instruction set variant of the escape-time kernel family,
+** batch_dd iterates center + (dcr, dci) in double-double, batch_float
+** the shallow views in float with twice the lanes, batch_fixed64 and
+** batch_fixed128 center + (dcr, dci) in Q4.60 and Q4.124. batch advances
+** interleave independent sets of lanes together, the factor is picked
+** per cpu by the dispatcher.
+*/
+
+typedef struct
+{
+	const char		*name;
+	int				lanes;
+	bool			(*supported)(void);
+	void			(*batch)(const double *re, const double *im, int *out, size_t n, int iterations,
+							 double tolerance, int interleave);
+	void			(*batch_dd)(DoubleDouble center_re, DoubleDouble center_im, const double *dcr, const double *dci,
+								int *out, size_t n, int iterations);
+	void			(*batch_float)(const float *re, const float *im, int *out, size_t n, int iterations,
+								   float tolerance, int interleave);
+	void			(*batch_fixed64)(Fixed128 center_re, Fixed128 center_im, const double *dcr,
+									 const double *dci, int *out, size_t n, int iterations);
+	void			(*batch_fixed128)(Fixed128 center_re, Fixed128 center_im, const double *dcr,
+									  const double *dci, int *out, size_t n, int iterations);
+}					Kernel;
+
+/*
+** About 4000 bits, radii down to 1e-1200
+*/
+
+# define MANDEL_BIG_LIMBS 128
+
+/*
+** Fixed point number of size limbs in use, see big.c
+*/
+
+typedef struct
+{
+	bool			negative;
+	int				size;
+	uint32_t		limbs[MANDEL_BIG_LIMBS];
+}					Big;
+
+/*
+** Reference orbit for perturbation, see orbit.c. The real and imaginary
+** parts are stored apart in one mapping, as doubles or compressed
+** to floats, ORBIT_RE and ORBIT_IM read either.
+*/
+
+typedef struct
+{
+	void			*data;
+	size_t			size;
+	double			*re;
+	double			*im;
+	float			*re_float;
+	float			*im_float;
+	bool			compressed;
+	bool			cached;
+	int				length;
+	int				iterations;
+	int				precision;
+	Big				center_real;
+	Big				center_imag;
+}					Orbit;
+
+/*
+** Directory of the on-disk orbit cache (none when NULL) and its size
+** limit in bytes, see orbit_cache.c
+*/
+
+typedef struct
+{
+	const char		*directory;
+	size_t			limit;
+}					OrbitCache;
+
+# define ORBIT_RE(orbit, m) ((orbit)->compressed ? (double)(orbit)->re_float[m] : (orbit)->re[m])
+# define ORBIT_IM(orbit, m) ((orbit)->compressed ? (double)(orbit)->im_float[m] : (orbit)->im[m])
+
+/*
+** Series approximation coefficients at iteration skip, see series.c
+*/
+
+typedef struct
+{
+	int				skip;
+	double			scale;
+	double			a_re;
+	double			a_im;
+	double			b_re;
+	double			b_im;
+	double			c_re;
+	double			c_im;
+}					Series;
+
+/*
+** Bilinear approximation of length iterations: dz -> A dz + B dc,
+** see bla.c for the table of levels
+*/
+
+typedef struct
+{
+	double			a_re;
+	double			a_im;
+	double			b_re;
+	double			b_im;
+	double			radius;
+	int				length;
+}					Bla;
+
+typedef struct
+{
+	Bla				**levels;
+	int				*counts;
+	int				levels_count;
+}					BlaTable;
+
+/*
+** Everything a perturbation render iterates against, offset from the
+** center of the view. Offsets are scaled by 2^-exponent, the ones it
+** receives are from its own center.
+*/
+
+typedef struct
+{
+	Orbit			orbit;
+	Series			series;
+	BlaTable		bla;
+	Point			offset;
+	int				exponent;
+	bool			rebase;
+}					Reference;
+
+# define MANDEL_REFERENCE_GRID_MAX 4
+# define MANDEL_REFERENCES_MAX (MANDEL_REFERENCE_GRID_MAX * MANDEL_REFERENCE_GRID_MAX + 1)
+
+typedef struct
+{
+	long			computed;
+	long			filled;
+	long			corrected;
+	int				references;
+	int				precision;
+}					RenderStats;
+
+typedef struct s_pool	Pool;
+
+/*
+** Pool thread with its deque of task indices in [bottom, top)
+*/
+
+typedef struct
+{
+	pthread_t		thread;
+	pthread_mutex_t	lock;
+	int				*tasks;
+	int				capacity;
+	int				bottom;
+	int				top;
+	Pool			*pool;
+	int				self;
+	unsigned int	seed;
+}					Worker;
+
+struct				s_pool
+{
+	Worker			*workers;
+	int				size;
+	pthread_mutex_t	lock;
+	pthread_cond_t	start;
+	pthread_cond_t	done;
+	unsigned long	generation;
+	int				finished;
+	bool			quit;
+	void			(*func)(void *arg, int worker, int task);
+	void			*arg;
+};
+
 typedef struct
 {
 	unsigned int	id;
@@ -77,9 +330,28 @@ typedef struct
 		int			texture;
 		int			smooth;
 		int			samples;
+		int			period_tolerance;
+		int			period_color;
 	}				location;
 }					Shader;
 
+/*
+** Program drawing escape counts rendered on the CPU
+*/
+
+typedef struct
+{
+	unsigned int	id;
+	struct
+	{
+		int			iterations;
+		int			counts;
+		int			periods;
+		int			period_color;
+		int			texture;
+	}				location;
+}					CountsShader;
+
 typedef struct
 {
     SDL_Window		*window;
@@ -93,6 +365,13 @@ typedef struct
 	unsigned int	texture;
 
 	Shader			shader;
+	CountsShader	counts_shader;
+	unsigned int	counts_texture;
+	unsigned int	periods_texture;
+	int				*counts;
+	int				*periods;
+	bool			dirty;
+	Pool			pool;
 
     // Color			*palette;
 
@@ -100,13 +379,196 @@ typedef struct
 	double			real_end;
 	double			imag_start;
 	double			imag_end;
+	Big				center_real;
+	Big				center_imag;
+	double			radius_real;
+	double			radius_imag;
+	int				radius_exponent;
+	int				precision;
+	Reference		references[MANDEL_REFERENCES_MAX];
+	int				references_count;
+	int				reference_grid;
 	int				iterations;
+	double			period_tolerance;
+	int				render_mode;
+	bool			rebase;
+	bool			orbit_float;
+	OrbitCache		orbit_cache;
 	bool			smooth;
+	bool			period_color;
 	float			samples;
 }					State;
 
 // mandelbrot.c
-int					mandelbrot(double ca, double cb, int iterations);
+int					mandelbrot(double ca, double cb, int iterations, double tolerance, int *period);
+int					mandelbrot_unrolled(double ca, double cb, int iterations, double tolerance);
+void				mandelbrot_batch(const double *re, const double *im, int *out, int *period, size_t n, int iterations,
+									 double tolerance);
+void				mandelbrot_batch_scalar(const double *re, const double *im, int *out, size_t n, int iterations,
+											double tolerance, int interleave);
+void				mandelbrot_batch_unrolled(const double *re, const double *im, int *out, size_t n, int iterations,
+											  double tolerance, int interleave);
+
+// mandelbrot_sse2.c
+void				mandelbrot_batch_sse2(const double *re, const double *im, int *out, size_t n, int iterations,
+											double tolerance, int interleave);
+
+// mandelbrot_avx2.c
+void				mandelbrot_batch_avx2(const double *re, const double *im, int *out, size_t n, int iterations,
+											double tolerance, int interleave);
+
+// mandelbrot_avx512.c
+void				mandelbrot_batch_avx512(const double *re, const double *im, int *out, size_t n, int iterations,
+											double tolerance, int interleave);
+
+// mandelbrot_float.c
+int					mandelbrot_float(float ca, float cb, int iterations, float tolerance, int *period);
+void				mandelbrot_float_batch(const float *re, const float *im, int *out, int *period, size_t n,
+										   int iterations, float tolerance);
+void				mandelbrot_float_batch_scalar(const float *re, const float *im, int *out, size_t n,
+												  int iterations, float tolerance, int interleave);
+
+// mandelbrot_float_sse2.c
+void				mandelbrot_float_batch_sse2(const float *re, const float *im, int *out, size_t n,
+												int iterations, float tolerance, int interleave);
+
+// mandelbrot_float_avx2.c
+void				mandelbrot_float_batch_avx2(const float *re, const float *im, int *out, size_t n,
+												int iterations, float tolerance, int interleave);
+
+// mandelbrot_float_avx512.c
+void				mandelbrot_float_batch_avx512(const float *re, const float *im, int *out, size_t n,
+												  int iterations, float tolerance, int interleave);
+
+// floatexp.c
+FloatExp			fe_make(double mantissa, int exponent);
+double				fe_to_double(FloatExp a);
+bool				fe_from_string(FloatExp *r, const char *str);
+FloatExp			fe_add(FloatExp a, FloatExp b);
+FloatExp			fe_sub(FloatExp a, FloatExp b);
+FloatExp			fe_mul(FloatExp a, FloatExp b);
+FloatExp			fe_mul_double(FloatExp a, double b);
+
+// double_double.c
+DoubleDouble		dd_from_big(const Big *a);
+int					mandelbrot_dd(DoubleDouble center_re, DoubleDouble center_im, double dcr, double dci, int iterations);
+void				mandelbrot_dd_batch(DoubleDouble center_re, DoubleDouble center_im, const double *dcr, const double *dci,
+										int *out, size_t n, int iterations);
+void				mandelbrot_dd_batch_scalar(DoubleDouble center_re, DoubleDouble center_im,
+											   const double *dcr, const double *dci, int *out, size_t n, int iterations);
+
+// double_double_avx2.c
+void				mandelbrot_dd_batch_avx2(DoubleDouble center_re, DoubleDouble center_im,
+											 const double *dcr, const double *dci, int *out, size_t n, int iterations);
+
+// double_double_avx512.c
+void				mandelbrot_dd_batch_avx512(DoubleDouble center_re, DoubleDouble center_im,
+											   const double *dcr, const double *dci, int *out, size_t n, int iterations);
+
+// fixed.c
+Fixed128			fixed_from_big(const Big *a);
+bool				fixed_supported(const State *state);
+int64_t				fixed64_offset(Fixed128 center, double offset);
+Fixed128			fixed128_offset(Fixed128 center, double offset);
+int					mandelbrot_fixed64(int64_t cr, int64_t ci, int iterations);
+int					mandelbrot_fixed128(Fixed128 cr, Fixed128 ci, int iterations);
+void				mandelbrot_fixed_batch(int precision, Fixed128 center_re, Fixed128 center_im,
+										   const double *dcr, const double *dci, int *out, size_t n, int iterations);
+void				mandelbrot_fixed64_batch_scalar(Fixed128 center_re, Fixed128 center_im,
+													const double *dcr, const double *dci, int *out, size_t n,
+													int iterations);
+void				mandelbrot_fixed128_batch_scalar(Fixed128 center_re, Fixed128 center_im,
+													 const double *dcr, const double *dci, int *out, size_t n,
+													 int iterations);
+
+// fixed_avx2.c
+void				mandelbrot_fixed64_batch_avx2(Fixed128 center_re, Fixed128 center_im,
+												  const double *dcr, const double *dci, int *out, size_t n,
+												  int iterations);
+
+// fixed_avx512.c
+void				mandelbrot_fixed64_batch_avx512(Fixed128 center_re, Fixed128 center_im,
+													const double *dcr, const double *dci, int *out, size_t n,
+													int iterations);
+void				mandelbrot_fixed128_batch_avx512(Fixed128 center_re, Fixed128 center_im,
+													 const double *dcr, const double *dci, int *out, size_t n,
+													 int iterations);
+
+// big.c
+void				big_zero(Big *r);
+void				big_set_precision(Big *r, int size);
+void				big_from_double(Big *r, double value);
+void				big_from_floatexp(Big *r, FloatExp value);
+double				big_to_double(const Big *a);
+bool				big_from_string(Big *r, const char *str);
+void				big_add(Big *r, const Big *a, const Big *b);
+void				big_sub(Big *r, const Big *a, const Big *b);
+void				big_mul(Big *r, const Big *a, const Big *b);
+void				big_mul_2(Big *r, const Big *a);
+bool				big_is_zero(const Big *a);
+bool				big_equal(const Big *a, const Big *b);
+
+// orbit.c
+bool				orbit_compute(Orbit *orbit, const Big *center_real, const Big *center_imag,
+									  FloatExp radius, int iterations, bool compressed,
+									  const OrbitCache *cache);
+bool				orbit_supported(FloatExp radius);
+void				orbit_free(Orbit *orbit);
+
+// orbit_cache.c
+bool				orbit_cache_load(Orbit *orbit, const OrbitCache *cache, const Big *center_real,
+									 const Big *center_imag, int precision, int iterations, bool compressed);
+void				orbit_cache_store(const Orbit *orbit, const OrbitCache *cache);
+
+// reference.c
+bool				references_prepare(State *state);
+const Reference		*references_nearest(const State *state, Point offset);
+void				references_free(State *state);
+
+// perturbation.c
+bool				perturbation_prepare(Reference *reference, const State *state, Point offset);
+void				perturbation_free(Reference *reference);
+int					perturbation(const Reference *reference, double dcr, double dci, int iterations, bool *glitched);
+void				perturbation_batch(const Reference *reference, const double *dcr, const double *dci,
+									   int *out, bool *glitched, size_t n, int iterations);
+
+// glitch.c
+bool				glitch_correct(State *state, int *counts, unsigned char *status,
+								   Point origin, Point step, RenderStats *stats);
+
+// series.c
+void				series_compute(Series *series, const Orbit *orbit,
+								   double radius_real, double radius_imag, int iterations);
+void				series_evaluate(const Series *series, double ur, double ui, double *dzr, double *dzi);
+
+// bla.c
+bool				bla_compute(BlaTable *bla, const Orbit *orbit, double dc_max);
+const Bla			*bla_lookup(const BlaTable *bla, int m, double dz_norm, int remaining);
+void				bla_free(BlaTable *bla);
+
+// view.c
+void				view_from_bounds(State *state);
+void				view_to_bounds(State *state);
+void				view_normalize(State *state);
+void				view_zoom(State *state, double factor);
+void				view_move(State *state, double real, double imag);
+
+// dispatch.c
+void				dispatch_init(void);
+const Kernel		*dispatch_kernel(void);
+int					dispatch_interleave(void);
+
+// pool.c
+bool				pool_init(Pool *pool, int size);
+void				pool_quit(Pool *pool);
+bool				pool_run(Pool *pool, int count, void (*func)(void *arg, int worker, int task), void *arg);
+
+// precision.c
+int					precision_select(const State *state);
+const char			*precision_name(int precision);
+
+// render.c
+bool				render_cpu(State *state, int *counts, int *periods, RenderStats *stats);
 
 // state.c
 bool				state_init(State *state);
@@ -123,9 +585,19 @@ void				error_check_gl(const char *code, const char *filename, int line_num);
 
 // color.c
 unsigned int		color_texture_new(int iterations);
+Color				*color_palette_new(int count);
+
+// image.c
+bool				image_write_ppm(const char *filepath, const int *counts, const int *periods, int width, int height,
+									int iterations);
+
+// headless.c
+int					headless_render(int argc, char **argv);
 
 // shader.c
 bool				shader_init(Shader *shader);
 void				shader_set_uniforms(Shader *shader, State *state);
+bool				shader_counts_init(CountsShader *shader);
+void				shader_counts_set_uniforms(CountsShader *shader, State *state);
 
 #endif
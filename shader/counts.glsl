@@ -0,0 +1,33 @@
+#version 400 core
+
+out vec4            out_color;
+
+uniform isampler2D  u_counts;
+uniform isampler2D  u_periods;
+uniform int         u_iterations;
+uniform bool        u_period_color;
+
+uniform sampler1D   u_texture;
+
+#define PERIOD_STEP 0.6180339887
+
+// like period_color() in fragment.glsl
+vec4    period_color(int period)
+{
+    return vec4(texture(u_texture, fract(float(period) * PERIOD_STEP)).rgb * 0.5, 1.0);
+}
+
+// escape counts rendered on the CPU, colored like mandelbrot_color()
+// in fragment.glsl, row 0 at the bottom like gl_FragCoord
+void main()
+{
+    int     n = texelFetch(u_counts, ivec2(gl_FragCoord.xy), 0).r;
+    int     period = texelFetch(u_periods, ivec2(gl_FragCoord.xy), 0).r;
+
+    if (n < u_iterations)
+        out_color = texture(u_texture, float(n) / float(u_iterations));
+    else if (u_period_color && period > 0)
+        out_color = period_color(period);
+    else
+        out_color = vec4(0.0, 0.0, 0.0, 1.0);
+}
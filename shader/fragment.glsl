@@ -13,20 +13,68 @@ uniform float       u_imag_end;
 uniform int         u_iterations;
 uniform bool        u_smooth;
 uniform float       u_samples;
+uniform float       u_period_tolerance;
+uniform bool        u_period_color;
 
 uniform sampler1D   u_texture;
 
 #define ESCAPE_RADIUS 4.0
 #define LOG_2 0.69314718056
+#define PERIOD_STEP 0.6180339887
 
 
-int     mandelbrot_func(vec2 c)
+// main cardioid and period-2 bulb, points inside never escape
+bool    mandelbrot_interior(vec2 c)
+{
+    float   x = c.x - 0.25;
+    float   y_square = c.y * c.y;
+    float   q = x * x + y_square;
+
+    if (q * (q + x) <= 0.25 * y_square)
+        return true;
+    return (c.x + 1.0) * (c.x + 1.0) + y_square <= 0.0625;
+}
+
+// first return of z within the square root of the tolerance, a multiple
+// of it was met, see st_period() in src/mandelbrot.c
+int     cycle_period(vec2 c, vec2 z, int cycle)
+{
+    vec2    w;
+    vec2    w_square;
+
+    w = z;
+    for (int k = 1; k < cycle; k++)
+    {
+        w_square = w * w;
+        w.y = 2.0 * w.x * w.y;
+        w.x = w_square.x - w_square.y;
+        w += c;
+        if (abs(w.x - z.x) <= sqrt(u_period_tolerance) && abs(w.y - z.y) <= sqrt(u_period_tolerance))
+            return k;
+    }
+    return cycle;
+}
+
+// Brent cycle detection, see mandelbrot() in src/mandelbrot.c
+// the period is 0 when unknown, a negative tolerance disables the detection
+int     mandelbrot_periodic(vec2 c, out vec2 z, out int period)
 {
-    vec2    z;
     vec2    z_square;
+    vec2    saved;
+    int     cycle;
+    int     cycle_limit;
     int     n;
 
+    period = 0;
+    if (mandelbrot_interior(c))
+    {
+        period = c.x < -0.75 ? 2 : 1;
+        return u_iterations;
+    }
     z = c;
+    saved = z;
+    cycle = 0;
+    cycle_limit = 1;
     for (n = 0; n < u_iterations; n++)
     {
         z_square = z * z;
@@ -35,26 +83,37 @@ int     mandelbrot_func(vec2 c)
         z.y = 2.0 * z.x * z.y;
         z.x = z_square.x - z_square.y;
         z += c;
+
+        cycle++;
+        if (abs(z.x - saved.x) <= u_period_tolerance && abs(z.y - saved.y) <= u_period_tolerance)
+        {
+            period = cycle_period(c, z, cycle);
+            return u_iterations;
+        }
+        if (cycle == cycle_limit)
+        {
+            cycle = 0;
+            cycle_limit *= 2;
+            saved = z;
+        }
     }
     return n;
 }
 
-float   mandelbrot_smooth(vec2 c)
+int     mandelbrot_func(vec2 c, out int period)
+{
+    vec2    z;
+
+    return mandelbrot_periodic(c, z, period);
+}
+
+float   mandelbrot_smooth(vec2 c, out int period)
 {
     vec2    z;
     vec2    z_square;
     int     n;
 
-    z = c;
-    for (n = 0; n < u_iterations; n++)
-    {
-        z_square = z * z;
-        if (z_square.x + z_square.y > ESCAPE_RADIUS)
-            break;
-        z.y = 2.0 * z.x * z.y;
-        z.x = z_square.x - z_square.y;
-        z += c;
-    }
+    n = mandelbrot_periodic(c, z, period);
     if (n == u_iterations)
         return float(n);
     // http://linas.org/art-gallery/escape/escape.html
@@ -70,17 +129,25 @@ float   mandelbrot_smooth(vec2 c)
     return float(n) - log(log(modulus)) / LOG_2;
 }
 
+// inside the set, the palette at the period times the golden ratio at half
+// brightness, see image_write_ppm() in src/image.c
+vec4    period_color(int period)
+{
+    return vec4(texture(u_texture, fract(float(period) * PERIOD_STEP)).rgb * 0.5, 1.0);
+}
+
 vec4   mandelbrot_color(vec2 c)
 {
     float   n;
+    int     period;
 
     if (u_smooth)
-        n = mandelbrot_smooth(c);
+        n = mandelbrot_smooth(c, period);
     else
-        n = float(mandelbrot_func(c));
+        n = float(mandelbrot_func(c, period));
 
     if (n == float(u_iterations))
-        return vec4(0.0, 0.0, 0.0, 1.0);
+        return u_period_color && period > 0 ? period_color(period) : vec4(0.0, 0.0, 0.0, 1.0);
     else
         return texture(u_texture, n / float(u_iterations));
 
@@ -0,0 +1,262 @@
+#include "mandel.h"
+
+/*
+** Fixed point numbers with MANDEL_BIG_LIMBS 32 bit limbs, least significant
+** first: the last limb is the integer part, the others the fraction.
+** The sign is kept apart so arithmetic works on magnitudes.
+** Only the size most significant limbs are in use, the others are ignored,
+** and results get the smaller size of the operands so the cost of the
+** arithmetic follows the precision asked for with big_set_precision.
+*/
+
+#define LIMB_BITS 32
+#define INT_LIMB (MANDEL_BIG_LIMBS - 1)
+#define FIRST_LIMB(size) (MANDEL_BIG_LIMBS - (size))
+
+static int	st_cmp_magnitude(const Big *a, const Big *b);
+static void	st_add_magnitude(Big *r, const Big *a, const Big *b);
+static void	st_sub_magnitude(Big *r, const Big *a, const Big *b);
+static void	st_div_small(Big *r, uint32_t divisor);
+
+void	big_zero(Big *r)
+{
+	memset(r, 0, sizeof(Big));
+	r->size = MANDEL_BIG_LIMBS;
+}
+
+/*
+** Keeps size limbs (the integer one included), limbs brought back in use
+** by a larger size are cleared.
+*/
+
+void	big_set_precision(Big *r, int size)
+{
+	size = MAX(1, MIN(size, MANDEL_BIG_LIMBS));
+	for (int i = FIRST_LIMB(size); i < FIRST_LIMB(r->size); i++)
+		r->limbs[i] = 0;
+	r->size = size;
+}
+
+void	big_from_double(Big *r, double value)
+{
+	big_zero(r);
+	r->negative = value < 0.0;
+	value = fabs(value);
+	for (int i = INT_LIMB; i >= 0 && value != 0.0; i--)
+	{
+		double	limb = floor(value);
+
+		r->limbs[i] = (uint32_t)limb;
+		value = ldexp(value - limb, LIMB_BITS);
+	}
+}
+
+/*
+** Shifted down limb by limb and bit by bit, the value may be under
+** the range of a double
+*/
+
+void	big_from_floatexp(Big *r, FloatExp value)
+{
+	int		limbs = -value.exponent / LIMB_BITS;
+	int		bits = -value.exponent % LIMB_BITS;
+
+	if (value.exponent >= 0)
+	{
+		big_from_double(r, ldexp(value.mantissa, value.exponent));
+		return ;
+	}
+	big_from_double(r, value.mantissa);
+	for (int i = 0; i < MANDEL_BIG_LIMBS; i++)
+	{
+		uint64_t	low = i + limbs < MANDEL_BIG_LIMBS ? r->limbs[i + limbs] : 0;
+		uint64_t	high = i + limbs + 1 < MANDEL_BIG_LIMBS ? r->limbs[i + limbs + 1] : 0;
+
+		r->limbs[i] = (uint32_t)(((high << LIMB_BITS) | low) >> bits);
+	}
+}
+
+double	big_to_double(const Big *a)
+{
+	double	value = 0.0;
+
+	for (int i = FIRST_LIMB(a->size); i <= INT_LIMB; i++)
+		value += ldexp(a->limbs[i], LIMB_BITS * (i - INT_LIMB));
+	return a->negative ? -value : value;
+}
+
+/*
+** Plain decimal notation: [-]digits[.digits]
+*/
+
+bool	big_from_string(Big *r, const char *str)
+{
+	const char	*dot;
+	const char	*end;
+	bool		negative;
+
+	big_zero(r);
+	if ((negative = *str == '-') || *str == '+')
+		str++;
+	if ((dot = strchr(str, '.')) == NULL)
+		dot = str + strlen(str);
+	end = dot + (*dot == '.' ? strlen(dot) : 0);
+	if (dot == str && end - dot <= 1)
+		return false;
+	for (const char *c = end - 1; c > dot; c--)
+	{
+		if (*c < '0' || *c > '9')
+			return false;
+		r->limbs[INT_LIMB] += *c - '0';
+		st_div_small(r, 10);
+	}
+	for (const char *c = str; c < dot; c++)
+	{
+		if (*c < '0' || *c > '9' || r->limbs[INT_LIMB] > (UINT32_MAX - 9) / 10)
+			return false;
+		r->limbs[INT_LIMB] = r->limbs[INT_LIMB] * 10 + (*c - '0');
+	}
+	r->negative = negative;
+	return true;
+}
+
+void	big_add(Big *r, const Big *a, const Big *b)
+{
+	r->size = MIN(a->size, b->size);
+	if (a->negative == b->negative)
+	{
+		st_add_magnitude(r, a, b);
+		r->negative = a->negative;
+	}
+	else if (st_cmp_magnitude(a, b) >= 0)
+	{
+		st_sub_magnitude(r, a, b);
+		r->negative = a->negative;
+	}
+	else
+	{
+		st_sub_magnitude(r, b, a);
+		r->negative = b->negative;
+	}
+}
+
+void	big_sub(Big *r, const Big *a, const Big *b)
+{
+	Big	negated = *b;
+
+	negated.negative = !b->negative;
+	big_add(r, a, &negated);
+}
+
+/*
+** Schoolbook product of the magnitudes (x and y indexing the limbs in use).
+** Only the partial products reaching the kept limbs or the one below are
+** summed, the others would only carry into the last kept limb, so the
+** result is truncated with an error of a few units of its last limb
+** for about half the work.
+*/
+
+void	big_mul(Big *r, const Big *a, const Big *b)
+{
+	uint32_t		product[2 * MANDEL_BIG_LIMBS] = {0};
+	int				size = MIN(a->size, b->size);
+	const uint32_t	*x = a->limbs + FIRST_LIMB(size);
+	const uint32_t	*y = b->limbs + FIRST_LIMB(size);
+	bool			negative = a->negative != b->negative;
+
+	for (int i = 0; i < size; i++)
+	{
+		uint64_t	carry = 0;
+
+		if (x[i] == 0)
+			continue ;
+		for (int j = MAX(0, size - 2 - i); j < size; j++)
+		{
+			uint64_t	t = (uint64_t)x[i] * y[j] + product[i + j] + carry;
+
+			product[i + j] = (uint32_t)t;
+			carry = t >> LIMB_BITS;
+		}
+		product[i + size] = (uint32_t)carry;
+	}
+	memcpy(r->limbs + FIRST_LIMB(size), product + size - 1, sizeof(uint32_t) * size);
+	r->size = size;
+	r->negative = negative && !big_is_zero(r);
+}
+
+void	big_mul_2(Big *r, const Big *a)
+{
+	uint32_t	carry = 0;
+
+	for (int i = FIRST_LIMB(a->size); i < MANDEL_BIG_LIMBS; i++)
+	{
+		uint32_t	limb = a->limbs[i];
+
+		r->limbs[i] = (limb << 1) | carry;
+		carry = limb >> (LIMB_BITS - 1);
+	}
+	r->size = a->size;
+	r->negative = a->negative;
+}
+
+bool	big_is_zero(const Big *a)
+{
+	for (int i = FIRST_LIMB(a->size); i < MANDEL_BIG_LIMBS; i++)
+		if (a->limbs[i] != 0)
+			return false;
+	return true;
+}
+
+bool	big_equal(const Big *a, const Big *b)
+{
+	return a->size == b->size
+		&& (a->negative == b->negative || big_is_zero(a))
+		&& st_cmp_magnitude(a, b) == 0;
+}
+
+static int	st_cmp_magnitude(const Big *a, const Big *b)
+{
+	for (int i = INT_LIMB; i >= FIRST_LIMB(MIN(a->size, b->size)); i--)
+		if (a->limbs[i] != b->limbs[i])
+			return a->limbs[i] < b->limbs[i] ? -1 : 1;
+	return 0;
+}
+
+static void	st_add_magnitude(Big *r, const Big *a, const Big *b)
+{
+	uint64_t	carry = 0;
+
+	for (int i = FIRST_LIMB(r->size); i < MANDEL_BIG_LIMBS; i++)
+	{
+		carry += (uint64_t)a->limbs[i] + b->limbs[i];
+		r->limbs[i] = (uint32_t)carry;
+		carry >>= LIMB_BITS;
+	}
+}
+
+// |a| >= |b|
+static void	st_sub_magnitude(Big *r, const Big *a, const Big *b)
+{
+	int64_t	borrow = 0;
+
+	for (int i = FIRST_LIMB(r->size); i < MANDEL_BIG_LIMBS; i++)
+	{
+		int64_t	t = (int64_t)a->limbs[i] - b->limbs[i] - borrow;
+
+		borrow = t < 0;
+		r->limbs[i] = (uint32_t)(t + (borrow << LIMB_BITS));
+	}
+}
+
+static void	st_div_small(Big *r, uint32_t divisor)
+{
+	uint64_t	remainder = 0;
+
+	for (int i = INT_LIMB; i >= FIRST_LIMB(r->size); i--)
+	{
+		uint64_t	t = (remainder << LIMB_BITS) | r->limbs[i];
+
+		r->limbs[i] = (uint32_t)(t / divisor);
+		remainder = t % divisor;
+	}
+}
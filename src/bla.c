@@ -0,0 +1,107 @@
+#include "mandel.h"
+#include "config.h"
+
+static void	st_merge(Bla *r, const Bla *x, const Bla *y, double dc_max);
+
+/*
+** Bilinear approximation table over the reference orbit.
+** An entry of level k maps dz_m to dz_m+2^k = A dz_m + B dc for m a multiple
+** of 2^k, valid while |dz_m| < radius. A single step is A = 2 Z_m, B = 1,
+** valid while the dropped dz^2 stays under MANDEL_BLA_EPSILON |2 Z_m dz|.
+** Level k+1 merges pairs of level k:
+** A = A_y A_x, B = A_y B_x + B_y, radius = min(R_x, (R_y - |B_x| dc_max) / |A_x|)
+*/
+
+bool		bla_compute(BlaTable *bla, const Orbit *orbit, double dc_max)
+{
+	int		count = orbit->length - 1;
+	int		levels = 0;
+
+	bla_free(bla);
+	while (count >> levels > 0 && levels < MANDEL_BLA_LEVELS_MAX)
+		levels++;
+	if (levels == 0)
+		return true;
+	if ((bla->levels = calloc(levels, sizeof(Bla *))) == NULL
+		|| (bla->counts = calloc(levels, sizeof(int))) == NULL)
+	{
+		bla_free(bla);
+		return false;
+	}
+	bla->levels_count = levels;
+	for (int k = 0; k < levels; k++)
+	{
+		bla->counts[k] = count >> k;
+		if ((bla->levels[k] = malloc(sizeof(Bla) * bla->counts[k])) == NULL)
+		{
+			bla_free(bla);
+			return false;
+		}
+	}
+	for (int m = 0; m < count; m++)
+	{
+		Bla		*step = &bla->levels[0][m];
+
+		step->a_re = 2.0 * ORBIT_RE(orbit, m);
+		step->a_im = 2.0 * ORBIT_IM(orbit, m);
+		step->b_re = 1.0;
+		step->b_im = 0.0;
+		step->radius = MANDEL_BLA_EPSILON * hypot(step->a_re, step->a_im);
+		step->length = 1;
+	}
+	for (int k = 1; k < levels; k++)
+		for (int j = 0; j < bla->counts[k]; j++)
+			st_merge(&bla->levels[k][j], &bla->levels[k - 1][2 * j],
+					&bla->levels[k - 1][2 * j + 1], dc_max);
+	return true;
+}
+
+/*
+** Longest step valid at reference iteration m for a delta of squared
+** norm dz_norm, that stays within the budget of remaining iterations.
+** A merged radius never exceeds the one of its first half, so the search
+** climbs from the single step and stops at the first level that fails.
+*/
+
+const Bla	*bla_lookup(const BlaTable *bla, int m, double dz_norm, int remaining)
+{
+	const Bla	*found = NULL;
+
+	for (int k = 0; k < bla->levels_count; k++)
+	{
+		const Bla	*step;
+
+		if ((m & ((1 << k) - 1)) != 0 || (m >> k) >= bla->counts[k] || (1 << k) > remaining)
+			break ;
+		step = &bla->levels[k][m >> k];
+		if (!(dz_norm < step->radius * step->radius))
+			break ;
+		found = step;
+	}
+	return found;
+}
+
+void		bla_free(BlaTable *bla)
+{
+	for (int k = 0; k < bla->levels_count; k++)
+		free(bla->levels[k]);
+	free(bla->levels);
+	free(bla->counts);
+	bla->levels = NULL;
+	bla->counts = NULL;
+	bla->levels_count = 0;
+}
+
+static void	st_merge(Bla *r, const Bla *x, const Bla *y, double dc_max)
+{
+	double	a_x = hypot(x->a_re, x->a_im);
+
+	r->a_re = y->a_re * x->a_re - y->a_im * x->a_im;
+	r->a_im = y->a_re * x->a_im + y->a_im * x->a_re;
+	r->b_re = y->a_re * x->b_re - y->a_im * x->b_im + y->b_re;
+	r->b_im = y->a_re * x->b_im + y->a_im * x->b_re + y->b_im;
+	r->radius = MIN(x->radius, (y->radius - hypot(x->b_re, x->b_im) * dc_max) / a_x);
+	if (!(r->radius > 0.0) || !isfinite(r->a_re + r->a_im + r->b_re + r->b_im))
+		r->radius = 0.0;
+	r->length = x->length + y->length;
+}
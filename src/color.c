@@ -1,8 +1,14 @@
 #include "mandel.h"
 #include "config.h"
 
-#define MAX(x, y) (x > y ? x : y)
-#define MIN(x, y) (x < y ? x : y)
+static ControlPoint g_theme[] = {
+	{0.0,    {0x00, 0x0F, 0x64} },
+	{0.16,   {0x20, 0x6B, 0xCB} },
+	{0.42,   {0xED, 0xFF, 0xFF} },
+	{0.6425, {0xFF, 0xAA, 0x00} },
+	{1.0,    {0x00, 0x02, 0x00} },
+	// {0.8575, {0x00, 0x02, 0x00} },
+};
 
 static Color	color_hsl_to_rgb(ColorHSL color_hsl);
 static Color	*st_hsl_rainbow(int count);
@@ -14,7 +20,7 @@ unsigned int	color_texture_new(int count)
 	unsigned int	texture;
 	Color			*palette;
 
-	if ((palette = st_hsl_rainbow(count)) == NULL)
+	if ((palette = color_palette_new(count)) == NULL)
 		return 0;
 	/* if ((palette = st_linear_iterpolation(count, g_theme, sizeof(g_theme) / sizeof(ControlPoint))) == NULL) */
 	/* 	return 0; */
@@ -27,6 +33,11 @@ unsigned int	color_texture_new(int count)
 	return texture;
 }
 
+Color			*color_palette_new(int count)
+{
+	return st_hsl_rainbow(count);
+}
+
 static Color	*st_linear_iterpolation(int count, ControlPoint *points, size_t points_count)
 {
 	Color			*palette;
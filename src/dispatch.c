@@ -0,0 +1,166 @@
+#include "mandel.h"
+#include "config.h"
+#include <time.h>
+
+#define MANDEL_KERNEL_ENV "MANDEL_KERNEL"
+#define MANDEL_INTERLEAVE_ENV "MANDEL_INTERLEAVE"
+
+static int	st_calibrate(const Kernel *kernel);
+static bool	st_supported_always(void);
+#ifdef MANDEL_X86
+static bool	st_supported_sse2(void);
+static bool	st_supported_avx2(void);
+static bool	st_supported_avx512(void);
+#endif
+
+/*
+** Ordered from the slowest to the fastest, the last supported one wins.
+** Two lanes of double-double or fixed point barely pay for the shuffling
+** so sse2 keeps the scalar ones, and so does avx2 for Q4.124 whose four
+** limbs per lane lose to the scalar __int128. The unrolled scalar loop
+** only runs when forced.
+*/
+
+static const Kernel	g_kernels[] = {
+	{"unrolled", 1, st_supported_always, mandelbrot_batch_unrolled, mandelbrot_dd_batch_scalar,
+		mandelbrot_float_batch_scalar,
+		mandelbrot_fixed64_batch_scalar, mandelbrot_fixed128_batch_scalar},
+	{"scalar", 1, st_supported_always, mandelbrot_batch_scalar, mandelbrot_dd_batch_scalar,
+		mandelbrot_float_batch_scalar,
+		mandelbrot_fixed64_batch_scalar, mandelbrot_fixed128_batch_scalar},
+#ifdef MANDEL_X86
+	{"sse2",   2, st_supported_sse2,   mandelbrot_batch_sse2,   mandelbrot_dd_batch_scalar,
+		mandelbrot_float_batch_sse2,
+		mandelbrot_fixed64_batch_scalar, mandelbrot_fixed128_batch_scalar},
+	{"avx2",   4, st_supported_avx2,   mandelbrot_batch_avx2,   mandelbrot_dd_batch_avx2,
+		mandelbrot_float_batch_avx2,
+		mandelbrot_fixed64_batch_avx2, mandelbrot_fixed128_batch_scalar},
+	{"avx512", 8, st_supported_avx512, mandelbrot_batch_avx512, mandelbrot_dd_batch_avx512,
+		mandelbrot_float_batch_avx512,
+		mandelbrot_fixed64_batch_avx512, mandelbrot_fixed128_batch_avx512},
+#endif
+};
+
+#define KERNELS_COUNT (sizeof(g_kernels) / sizeof(Kernel))
+
+static const Kernel	*g_kernel = NULL;
+static int			g_interleave = 1;
+
+void			dispatch_init(void)
+{
+	const char	*forced;
+	size_t		i;
+
+	if (g_kernel != NULL)
+		return ;
+#ifdef MANDEL_X86
+	__builtin_cpu_init();
+#endif
+	for (i = 0; i < KERNELS_COUNT; i++)
+		if (g_kernels[i].supported())
+			g_kernel = &g_kernels[i];
+
+	if ((forced = getenv(MANDEL_KERNEL_ENV)) != NULL && *forced != '\0')
+	{
+		for (i = 0; i < KERNELS_COUNT; i++)
+			if (strcmp(g_kernels[i].name, forced) == 0)
+				break;
+		if (i == KERNELS_COUNT)
+			fprintf(stderr, "[WARNING] unknown kernel %s=%s, using %s\n",
+					MANDEL_KERNEL_ENV, forced, g_kernel->name);
+		else if (!g_kernels[i].supported())
+			fprintf(stderr, "[WARNING] kernel %s not supported by this cpu, using %s\n",
+					forced, g_kernel->name);
+		else
+			g_kernel = &g_kernels[i];
+	}
+	if ((forced = getenv(MANDEL_INTERLEAVE_ENV)) == NULL || *forced == '\0')
+		g_interleave = st_calibrate(g_kernel);
+	else if (strcmp(forced, "1") == 0 || strcmp(forced, "2") == 0 || strcmp(forced, "4") == 0)
+		g_interleave = atoi(forced);
+	else
+	{
+		g_interleave = st_calibrate(g_kernel);
+		fprintf(stderr, "[WARNING] unknown interleave %s=%s, using %d\n",
+				MANDEL_INTERLEAVE_ENV, forced, g_interleave);
+	}
+}
+
+const Kernel	*dispatch_kernel(void)
+{
+	if (g_kernel == NULL)
+		dispatch_init();
+	return g_kernel;
+}
+
+int				dispatch_interleave(void)
+{
+	if (g_kernel == NULL)
+		dispatch_init();
+	return g_interleave;
+}
+
+/*
+** How many sets of lanes the kernel advances together pays off depends on
+** the latency of the cpu's multiply and add and on its register file, so
+** the fastest of 1, 2 and 4 is timed at startup on a row crossing the
+** seahorse valley, mostly escaping pixels of a few hundred iterations,
+** best of MANDEL_INTERLEAVE_RUNS runs
+*/
+
+static int	st_calibrate(const Kernel *kernel)
+{
+	double			re[MANDEL_INTERLEAVE_PIXELS];
+	double			im[MANDEL_INTERLEAVE_PIXELS];
+	int				out[MANDEL_INTERLEAVE_PIXELS];
+	struct timespec	start;
+	struct timespec	end;
+	double			best = INFINITY;
+	int				interleave = 1;
+
+	for (int i = 0; i < MANDEL_INTERLEAVE_PIXELS; i++)
+	{
+		re[i] = -0.7475 + 0.004 * i / MANDEL_INTERLEAVE_PIXELS;
+		im[i] = 0.11;
+	}
+	for (int factor = 1; factor <= 4; factor *= 2)
+	{
+		for (int run = 0; run < MANDEL_INTERLEAVE_RUNS; run++)
+		{
+			clock_gettime(CLOCK_MONOTONIC, &start);
+			kernel->batch(re, im, out, MANDEL_INTERLEAVE_PIXELS, MANDEL_INTERLEAVE_ITERATIONS,
+				MANDEL_PERIOD_TOLERANCE, factor);
+			clock_gettime(CLOCK_MONOTONIC, &end);
+			if ((end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9 < best)
+			{
+				best = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+				interleave = factor;
+			}
+		}
+	}
+	return interleave;
+}
+
+static bool	st_supported_always(void)
+{
+	return true;
+}
+
+#ifdef MANDEL_X86
+
+static bool	st_supported_sse2(void)
+{
+	return __builtin_cpu_supports("sse2");
+}
+
+static bool	st_supported_avx2(void)
+{
+	return __builtin_cpu_supports("avx2");
+}
+
+static bool	st_supported_avx512(void)
+{
+	return __builtin_cpu_supports("avx512f");
+}
+
+#endif
@@ -0,0 +1,119 @@
+#include "mandel.h"
+
+/*
+** Double-double numbers: an unevaluated sum hi + lo with |lo| <= ulp(hi) / 2,
+** about 106 bits of mantissa. Products are split the Dekker way instead of
+** relying on a fused multiply-add, so every kernel rounds the same way and
+** the SIMD variants give the counts of the scalar one.
+** The rounding adds up with every iteration so the depth it holds to
+** shrinks as the iteration count grows, see precision_select().
+*/
+
+#define SPLITTER 134217729.0
+
+static DoubleDouble	st_quick_two_sum(double a, double b);
+static DoubleDouble	st_two_sum(double a, double b);
+static DoubleDouble	st_two_prod(double a, double b);
+static DoubleDouble	st_add(DoubleDouble a, DoubleDouble b);
+static DoubleDouble	st_mul(DoubleDouble a, DoubleDouble b);
+
+DoubleDouble	dd_from_big(const Big *a)
+{
+	Big				rest;
+	DoubleDouble	r;
+
+	r.hi = big_to_double(a);
+	big_from_double(&rest, r.hi);
+	big_sub(&rest, a, &rest);
+	r.lo = big_to_double(&rest);
+	return r;
+}
+
+/*
+** Escape count of center + (dcr, dci) with the conventions of mandelbrot(),
+** without the interior and periodicity checks: both are done in double and
+** would be wrong at the depths this kernel is meant for.
+*/
+
+int				mandelbrot_dd(DoubleDouble center_re, DoubleDouble center_im, double dcr, double dci, int iterations)
+{
+	DoubleDouble	cr = st_add(center_re, (DoubleDouble){dcr, 0.0});
+	DoubleDouble	ci = st_add(center_im, (DoubleDouble){dci, 0.0});
+	DoubleDouble	zr = cr;
+	DoubleDouble	zi = ci;
+	DoubleDouble	zr_square;
+	DoubleDouble	zi_square;
+	DoubleDouble	zri;
+	int				n;
+
+	for (n = 0; n < iterations; n++)
+	{
+		if (zr.hi * zr.hi + zi.hi * zi.hi > 4.0)
+			return n;
+		zr_square = st_mul(zr, zr);
+		zi_square = st_mul(zi, zi);
+		zri = st_mul(zr, zi);
+		zr = st_add(st_add(zr_square, (DoubleDouble){-zi_square.hi, -zi_square.lo}), cr);
+		zi = st_add((DoubleDouble){2.0 * zri.hi, 2.0 * zri.lo}, ci);
+	}
+	return n;
+}
+
+void			mandelbrot_dd_batch(DoubleDouble center_re, DoubleDouble center_im, const double *dcr, const double *dci,
+									int *out, size_t n, int iterations)
+{
+	dispatch_kernel()->batch_dd(center_re, center_im, dcr, dci, out, n, iterations);
+}
+
+void			mandelbrot_dd_batch_scalar(DoubleDouble center_re, DoubleDouble center_im,
+										   const double *dcr, const double *dci, int *out, size_t n, int iterations)
+{
+	for (size_t i = 0; i < n; i++)
+		out[i] = mandelbrot_dd(center_re, center_im, dcr[i], dci[i], iterations);
+}
+
+// |a| >= |b|
+static DoubleDouble	st_quick_two_sum(double a, double b)
+{
+	double	s = a + b;
+
+	return (DoubleDouble){s, b - (s - a)};
+}
+
+static DoubleDouble	st_two_sum(double a, double b)
+{
+	double	s = a + b;
+	double	bb = s - a;
+
+	return (DoubleDouble){s, (a - (s - bb)) + (b - bb)};
+}
+
+static DoubleDouble	st_two_prod(double a, double b)
+{
+	double	p = a * b;
+	double	t = SPLITTER * a;
+	double	a_hi = t - (t - a);
+	double	a_lo = a - a_hi;
+
+	t = SPLITTER * b;
+	double	b_hi = t - (t - b);
+	double	b_lo = b - b_hi;
+
+	return (DoubleDouble){p, ((a_hi * b_hi - p) + a_hi * b_lo + a_lo * b_hi) + a_lo * b_lo};
+}
+
+static DoubleDouble	st_add(DoubleDouble a, DoubleDouble b)
+{
+	DoubleDouble	s = st_two_sum(a.hi, b.hi);
+	DoubleDouble	t = st_two_sum(a.lo, b.lo);
+
+	s = st_quick_two_sum(s.hi, s.lo + t.hi);
+	return st_quick_two_sum(s.hi, s.lo + t.lo);
+}
+
+static DoubleDouble	st_mul(DoubleDouble a, DoubleDouble b)
+{
+	DoubleDouble	p = st_two_prod(a.hi, b.hi);
+
+	return st_quick_two_sum(p.hi, p.lo + (a.hi * b.lo + a.lo * b.hi));
+}
@@ -0,0 +1,114 @@
+#include "mandel.h"
+
+#ifdef MANDEL_X86
+
+# pragma GCC target("avx2")
+# include <immintrin.h>
+
+# define LANES 4
+
+/*
+** mandelbrot_dd() on four lanes, operation for operation
+*/
+
+typedef struct
+{
+	__m256d	hi;
+	__m256d	lo;
+}			DoubleDouble4;
+
+static DoubleDouble4	st_quick_two_sum(__m256d a, __m256d b)
+{
+	__m256d	s = _mm256_add_pd(a, b);
+
+	return (DoubleDouble4){s, _mm256_sub_pd(b, _mm256_sub_pd(s, a))};
+}
+
+static DoubleDouble4	st_two_sum(__m256d a, __m256d b)
+{
+	__m256d	s = _mm256_add_pd(a, b);
+	__m256d	bb = _mm256_sub_pd(s, a);
+
+	return (DoubleDouble4){s, _mm256_add_pd(_mm256_sub_pd(a, _mm256_sub_pd(s, bb)), _mm256_sub_pd(b, bb))};
+}
+
+static DoubleDouble4	st_two_prod(__m256d a, __m256d b)
+{
+	const __m256d	splitter = _mm256_set1_pd(134217729.0);
+	__m256d			p = _mm256_mul_pd(a, b);
+	__m256d			t = _mm256_mul_pd(splitter, a);
+	__m256d			a_hi = _mm256_sub_pd(t, _mm256_sub_pd(t, a));
+	__m256d			a_lo = _mm256_sub_pd(a, a_hi);
+	__m256d			b_hi;
+	__m256d			b_lo;
+
+	t = _mm256_mul_pd(splitter, b);
+	b_hi = _mm256_sub_pd(t, _mm256_sub_pd(t, b));
+	b_lo = _mm256_sub_pd(b, b_hi);
+	return (DoubleDouble4){p, _mm256_add_pd(_mm256_add_pd(_mm256_add_pd(
+		_mm256_sub_pd(_mm256_mul_pd(a_hi, b_hi), p), _mm256_mul_pd(a_hi, b_lo)),
+		_mm256_mul_pd(a_lo, b_hi)), _mm256_mul_pd(a_lo, b_lo))};
+}
+
+static DoubleDouble4	st_add(DoubleDouble4 a, DoubleDouble4 b)
+{
+	DoubleDouble4	s = st_two_sum(a.hi, b.hi);
+	DoubleDouble4	t = st_two_sum(a.lo, b.lo);
+
+	s = st_quick_two_sum(s.hi, _mm256_add_pd(s.lo, t.hi));
+	return st_quick_two_sum(s.hi, _mm256_add_pd(s.lo, t.lo));
+}
+
+static DoubleDouble4	st_mul(DoubleDouble4 a, DoubleDouble4 b)
+{
+	DoubleDouble4	p = st_two_prod(a.hi, b.hi);
+
+	return st_quick_two_sum(p.hi, _mm256_add_pd(p.lo,
+		_mm256_add_pd(_mm256_mul_pd(a.hi, b.lo), _mm256_mul_pd(a.lo, b.hi))));
+}
+
+void	mandelbrot_dd_batch_avx2(DoubleDouble center_re, DoubleDouble center_im,
+								 const double *dcr, const double *dci, int *out, size_t n, int iterations)
+{
+	const __m256d		four = _mm256_set1_pd(4.0);
+	const __m256d		one = _mm256_set1_pd(1.0);
+	const __m256d		zero = _mm256_setzero_pd();
+	const __m256d		sign = _mm256_set1_pd(-0.0);
+	const DoubleDouble4	center_r = {_mm256_set1_pd(center_re.hi), _mm256_set1_pd(center_re.lo)};
+	const DoubleDouble4	center_i = {_mm256_set1_pd(center_im.hi), _mm256_set1_pd(center_im.lo)};
+	size_t				i;
+
+	for (i = 0; i + LANES <= n; i += LANES)
+	{
+		DoubleDouble4	cr = st_add(center_r, (DoubleDouble4){_mm256_loadu_pd(dcr + i), zero});
+		DoubleDouble4	ci = st_add(center_i, (DoubleDouble4){_mm256_loadu_pd(dci + i), zero});
+		DoubleDouble4	zr = cr;
+		DoubleDouble4	zi = ci;
+		__m256d			count = zero;
+		__m256d			active = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+
+		for (int k = 0; k < iterations; k++)
+		{
+			__m256d	inside = _mm256_cmp_pd(_mm256_add_pd(_mm256_mul_pd(zr.hi, zr.hi),
+				_mm256_mul_pd(zi.hi, zi.hi)), four, _CMP_LE_OQ);
+
+			active = _mm256_and_pd(active, inside);
+			if (_mm256_movemask_pd(active) == 0)
+				break;
+			count = _mm256_add_pd(count, _mm256_and_pd(active, one));
+
+			DoubleDouble4	zr_square = st_mul(zr, zr);
+			DoubleDouble4	zi_square = st_mul(zi, zi);
+			DoubleDouble4	zri = st_mul(zr, zi);
+
+			zr = st_add(st_add(zr_square, (DoubleDouble4){_mm256_xor_pd(zi_square.hi, sign),
+				_mm256_xor_pd(zi_square.lo, sign)}), cr);
+			zi = st_add((DoubleDouble4){_mm256_add_pd(zri.hi, zri.hi), _mm256_add_pd(zri.lo, zri.lo)}, ci);
+		}
+		_mm_storeu_si128((__m128i *)(out + i), _mm256_cvtpd_epi32(count));
+	}
+	for (; i < n; i++)
+		out[i] = mandelbrot_dd(center_re, center_im, dcr[i], dci[i], iterations);
+}
+
+#endif
@@ -0,0 +1,116 @@
+#include "mandel.h"
+
+#ifdef MANDEL_X86
+
+# pragma GCC target("avx512f")
+# include <immintrin.h>
+
+# define LANES 8
+
+/*
+** mandelbrot_dd() on eight lanes, operation for operation
+*/
+
+typedef struct
+{
+	__m512d	hi;
+	__m512d	lo;
+}			DoubleDouble8;
+
+// _mm512_xor_pd needs avx512dq
+static __m512d			st_negate(__m512d a)
+{
+	return _mm512_castsi512_pd(_mm512_xor_si512(_mm512_castpd_si512(a),
+		_mm512_set1_epi64(INT64_MIN)));
+}
+
+static DoubleDouble8	st_quick_two_sum(__m512d a, __m512d b)
+{
+	__m512d	s = _mm512_add_pd(a, b);
+
+	return (DoubleDouble8){s, _mm512_sub_pd(b, _mm512_sub_pd(s, a))};
+}
+
+static DoubleDouble8	st_two_sum(__m512d a, __m512d b)
+{
+	__m512d	s = _mm512_add_pd(a, b);
+	__m512d	bb = _mm512_sub_pd(s, a);
+
+	return (DoubleDouble8){s, _mm512_add_pd(_mm512_sub_pd(a, _mm512_sub_pd(s, bb)), _mm512_sub_pd(b, bb))};
+}
+
+static DoubleDouble8	st_two_prod(__m512d a, __m512d b)
+{
+	const __m512d	splitter = _mm512_set1_pd(134217729.0);
+	__m512d			p = _mm512_mul_pd(a, b);
+	__m512d			t = _mm512_mul_pd(splitter, a);
+	__m512d			a_hi = _mm512_sub_pd(t, _mm512_sub_pd(t, a));
+	__m512d			a_lo = _mm512_sub_pd(a, a_hi);
+	__m512d			b_hi;
+	__m512d			b_lo;
+
+	t = _mm512_mul_pd(splitter, b);
+	b_hi = _mm512_sub_pd(t, _mm512_sub_pd(t, b));
+	b_lo = _mm512_sub_pd(b, b_hi);
+	return (DoubleDouble8){p, _mm512_add_pd(_mm512_add_pd(_mm512_add_pd(
+		_mm512_sub_pd(_mm512_mul_pd(a_hi, b_hi), p), _mm512_mul_pd(a_hi, b_lo)),
+		_mm512_mul_pd(a_lo, b_hi)), _mm512_mul_pd(a_lo, b_lo))};
+}
+
+static DoubleDouble8	st_add(DoubleDouble8 a, DoubleDouble8 b)
+{
+	DoubleDouble8	s = st_two_sum(a.hi, b.hi);
+	DoubleDouble8	t = st_two_sum(a.lo, b.lo);
+
+	s = st_quick_two_sum(s.hi, _mm512_add_pd(s.lo, t.hi));
+	return st_quick_two_sum(s.hi, _mm512_add_pd(s.lo, t.lo));
+}
+
+static DoubleDouble8	st_mul(DoubleDouble8 a, DoubleDouble8 b)
+{
+	DoubleDouble8	p = st_two_prod(a.hi, b.hi);
+
+	return st_quick_two_sum(p.hi, _mm512_add_pd(p.lo,
+		_mm512_add_pd(_mm512_mul_pd(a.hi, b.lo), _mm512_mul_pd(a.lo, b.hi))));
+}
+
+void	mandelbrot_dd_batch_avx512(DoubleDouble center_re, DoubleDouble center_im,
+								   const double *dcr, const double *dci, int *out, size_t n, int iterations)
+{
+	const __m512d		four = _mm512_set1_pd(4.0);
+	const __m512i		one = _mm512_set1_epi64(1);
+	const __m512d		zero = _mm512_setzero_pd();
+	const DoubleDouble8	center_r = {_mm512_set1_pd(center_re.hi), _mm512_set1_pd(center_re.lo)};
+	const DoubleDouble8	center_i = {_mm512_set1_pd(center_im.hi), _mm512_set1_pd(center_im.lo)};
+
+	for (size_t i = 0; i < n; i += LANES)
+	{
+		__mmask8		active = n - i >= LANES ? 0xff : (__mmask8)((1u << (n - i)) - 1);
+		__mmask8		store = active;
+		DoubleDouble8	cr = st_add(center_r, (DoubleDouble8){_mm512_maskz_loadu_pd(active, dcr + i), zero});
+		DoubleDouble8	ci = st_add(center_i, (DoubleDouble8){_mm512_maskz_loadu_pd(active, dci + i), zero});
+		DoubleDouble8	zr = cr;
+		DoubleDouble8	zi = ci;
+		__m512i			count = _mm512_setzero_si512();
+
+		for (int k = 0; k < iterations; k++)
+		{
+			active = _mm512_mask_cmp_pd_mask(active, _mm512_add_pd(_mm512_mul_pd(zr.hi, zr.hi),
+				_mm512_mul_pd(zi.hi, zi.hi)), four, _CMP_LE_OQ);
+			if (active == 0)
+				break;
+			count = _mm512_mask_add_epi64(count, active, count, one);
+
+			DoubleDouble8	zr_square = st_mul(zr, zr);
+			DoubleDouble8	zi_square = st_mul(zi, zi);
+			DoubleDouble8	zri = st_mul(zr, zi);
+
+			zr = st_add(st_add(zr_square, (DoubleDouble8){st_negate(zi_square.hi),
+				st_negate(zi_square.lo)}), cr);
+			zi = st_add((DoubleDouble8){_mm512_add_pd(zri.hi, zri.hi), _mm512_add_pd(zri.lo, zri.lo)}, ci);
+		}
+		_mm512_mask_cvtepi64_storeu_epi32(out + i, store, count);
+	}
+}
+
+#endif
@@ -6,7 +6,7 @@ static void	st_move_horizontal(State *state, bool move_right);
 static void	st_move_vertical(State *state, bool move_down);
 static void	st_set_key(SDL_Keycode sym, bool value);
 static void	st_apply_keys(State *state);
-static void	st_resize(State *state, int new_width, int new_height);
+static void	st_resize(State *state);
 
 static bool	g_key_states[] = {
 	[KEY_UP]    = false,
@@ -36,6 +36,11 @@ void 		event_handle(State *state)
             case SDL_KEYDOWN:
 				if (e.key.keysym.sym == SDLK_s)
 					state->smooth = !state->smooth;
+				else if (e.key.keysym.sym == SDLK_p)
+				{
+					state->period_color = !state->period_color;
+					state->dirty = true;
+				}
 				else if (e.key.keysym.sym == SDLK_w)
 					state->samples += 1.0;
 				else if (e.key.keysym.sym == SDLK_q)
@@ -61,35 +66,28 @@ void 		event_handle(State *state)
 
 			case SDL_WINDOWEVENT:
 				if (e.window.event == SDL_WINDOWEVENT_RESIZED)
-					st_resize(state, e.window.data1, e.window.data2);
+					st_resize(state);
 				break;
         }
     }
 	st_apply_keys(state);
 }
 
-void		st_resize(State *state, int new_width, int new_height)
-{
-	double w_delta = ((double)new_width - (double)state->width) / 2.0;
-	double h_delta = ((double)new_height - (double)state->height) / 2.0;
-
-	double real_dist = state->real_end - state->real_start;
-	double imag_dist = state->imag_end - state->imag_start;
-
-	double width_real_ratio =  (double)state->width / real_dist;
-	double height_imag_ratio = (double)state->height / imag_dist;
-
-	w_delta /= width_real_ratio;
-	h_delta /= height_imag_ratio;
-
-	state->real_start -= w_delta;
-	state->real_end   += w_delta;
+/*
+** The pixels keep their size, the view grows or shrinks around its center
+*/
 
-	state->imag_start -= h_delta;
-	state->imag_end   += h_delta;
+void		st_resize(State *state)
+{
+	int		old_width = state->width;
+	int		old_height = state->height;
 
 	SDL_GL_GetDrawableSize(state->window, &state->width, &state->height);
 	GL_CALL(glViewport(0, 0, state->width, state->height));
+	state->radius_real *= (double)state->width / old_width;
+	state->radius_imag *= (double)state->height / old_height;
+	view_to_bounds(state);
+	state->dirty = true;
 }
 
 static void	st_set_key(SDL_Keycode sym, bool value)
@@ -132,12 +130,16 @@ static void	st_set_key(SDL_Keycode sym, bool value)
 static void	st_apply_keys(State *state)
 {
 	if (g_key_states[KEY_INC_ITERATIONS])
+	{
 		state->iterations += MANDEL_ITERATIONS_DELTA;
+		state->dirty = true;
+	}
 	if (g_key_states[KEY_DEC_ITERATIONS])
 	{
 		state->iterations -= MANDEL_ITERATIONS_DELTA;
 		if (state->iterations <= 0)
 			state->iterations = 1;
+		state->dirty = true;
 	}
 
 	if (g_key_states[KEY_UP])
@@ -155,17 +157,19 @@ static void	st_apply_keys(State *state)
 		st_zoom(state, false);
 }
 
+/*
+** The view moves on its high precision center and radii so zooming goes
+** on past the precision of the double bounds, see view.c
+*/
+
 #define MANDEL_ZOOM_RATIO 64
 
 static void	st_zoom(State *state, bool zoom_in)
 {
 	double factor = zoom_in ? 1 : -1;
-	double real_change = (state->real_end - state->real_start) / MANDEL_ZOOM_RATIO;
-	double imag_change = (state->imag_end - state->imag_start) / MANDEL_ZOOM_RATIO;
-	state->real_start += factor * real_change;
-	state->real_end -= factor * real_change;
-	state->imag_start += factor * imag_change;
-	state->imag_end -= factor * imag_change;
+
+	view_zoom(state, 1.0 - factor * 2.0 / MANDEL_ZOOM_RATIO);
+	state->dirty = true;
 }
 
 #define MANDEL_MOVE_RATIO 64
@@ -173,15 +177,15 @@ static void	st_zoom(State *state, bool zoom_in)
 static void	st_move_horizontal(State *state, bool move_right)
 {
 	double factor = move_right ? 1 : -1;
-	double real_change = (state->real_end - state->real_start) / MANDEL_MOVE_RATIO;
-	state->real_start += factor * real_change;
-	state->real_end += factor * real_change;
+
+	view_move(state, factor * 2.0 / MANDEL_MOVE_RATIO, 0.0);
+	state->dirty = true;
 }
 
 static void	st_move_vertical(State *state, bool move_down)
 {
 	double factor = move_down ? -1 : 1;
-	double imag_change = (state->imag_end - state->imag_start) / MANDEL_MOVE_RATIO;
-	state->imag_start += factor * imag_change;
-	state->imag_end += factor * imag_change;
+
+	view_move(state, 0.0, factor * 2.0 / MANDEL_MOVE_RATIO);
+	state->dirty = true;
 }
@@ -0,0 +1,187 @@
+#include "mandel.h"
+
+/*
+** Fixed point escape-time kernels, an alternative to double-double:
+** Q4.60 in an int64 (about 1e-18 steps, zooms to about 1e-15) and
+** Q4.124 in 128 bits (about 5e-38, zooms to about 1e-34), two's
+** complement. Products are truncated toward zero from the full product
+** of the magnitudes so the SIMD variants, which build it from 32 bit
+** limbs, give the same counts. Z never leaves the [-8, 8) range of the
+** integer part while c is in [-4, 4): a component past 2 escapes before
+** squaring and the squares are summed only once both are at most 4, so
+** the next z is at most 4 plus c, see fixed_supported().
+*/
+
+__extension__ typedef __int128			t_int128;
+__extension__ typedef unsigned __int128	t_uint128;
+
+#define FIXED64_TWO ((int64_t)2 << 60)
+#define FIXED64_FOUR ((uint64_t)4 << 60)
+#define FIXED128_TWO ((t_int128)2 << 124)
+#define FIXED128_FOUR ((t_uint128)4 << 124)
+
+static t_int128		st_to_int128(Fixed128 a);
+static Fixed128		st_from_int128(t_int128 a);
+static int64_t		st_mul64(int64_t a, int64_t b);
+static t_int128		st_mul128(t_int128 a, t_int128 b);
+
+/*
+** Q4.124 of a Big, truncated, its integer part must fit in 3 bits
+*/
+
+Fixed128	fixed_from_big(const Big *a)
+{
+	t_uint128	magnitude = (t_uint128)a->limbs[MANDEL_BIG_LIMBS - 1] << 124;
+	t_uint128	fraction = 0;
+
+	for (int i = 1; i <= 4; i++)
+		if (MANDEL_BIG_LIMBS - 1 - i >= MANDEL_BIG_LIMBS - a->size)
+			fraction |= (t_uint128)a->limbs[MANDEL_BIG_LIMBS - 1 - i] << (128 - 32 * i);
+	magnitude |= fraction >> 4;
+	return st_from_int128(a->negative ? -(t_int128)magnitude : (t_int128)magnitude);
+}
+
+/*
+** Whether every c of the view is in [-4, 4) on both axes, past that z
+** wraps around the integer part and the counts are garbage
+*/
+
+bool		fixed_supported(const State *state)
+{
+	return state->real_start >= -4.0 && state->real_end < 4.0
+		&& state->imag_start >= -4.0 && state->imag_end < 4.0;
+}
+
+/*
+** Q4.60 of center + offset, the center rounded down to its high half
+*/
+
+int64_t		fixed64_offset(Fixed128 center, double offset)
+{
+	return center.hi + (int64_t)ldexp(offset, 60);
+}
+
+/*
+** Q4.124 of center + offset, exact unless the offset is below 2^-124
+*/
+
+Fixed128	fixed128_offset(Fixed128 center, double offset)
+{
+	return st_from_int128(st_to_int128(center) + (t_int128)ldexp(offset, 124));
+}
+
+/*
+** Escape counts with the conventions of mandelbrot_dd()
+*/
+
+int			mandelbrot_fixed64(int64_t cr, int64_t ci, int iterations)
+{
+	int64_t	zr = cr;
+	int64_t	zi = ci;
+	int64_t	zr_square;
+	int64_t	zi_square;
+	int		n;
+
+	for (n = 0; n < iterations; n++)
+	{
+		if (zr > FIXED64_TWO || zr < -FIXED64_TWO || zi > FIXED64_TWO || zi < -FIXED64_TWO)
+			return n;
+		zr_square = st_mul64(zr, zr);
+		zi_square = st_mul64(zi, zi);
+		if ((uint64_t)zr_square + (uint64_t)zi_square > FIXED64_FOUR)
+			return n;
+		zi = 2 * st_mul64(zr, zi) + ci;
+		zr = zr_square - zi_square + cr;
+	}
+	return n;
+}
+
+int			mandelbrot_fixed128(Fixed128 cr, Fixed128 ci, int iterations)
+{
+	t_int128	c_r = st_to_int128(cr);
+	t_int128	c_i = st_to_int128(ci);
+	t_int128	zr = c_r;
+	t_int128	zi = c_i;
+	t_int128	zr_square;
+	t_int128	zi_square;
+	int			n;
+
+	for (n = 0; n < iterations; n++)
+	{
+		if (zr > FIXED128_TWO || zr < -FIXED128_TWO || zi > FIXED128_TWO || zi < -FIXED128_TWO)
+			return n;
+		zr_square = st_mul128(zr, zr);
+		zi_square = st_mul128(zi, zi);
+		if ((t_uint128)zr_square + (t_uint128)zi_square > FIXED128_FOUR)
+			return n;
+		zi = 2 * st_mul128(zr, zi) + c_i;
+		zr = zr_square - zi_square + c_r;
+	}
+	return n;
+}
+
+void		mandelbrot_fixed_batch(int precision, Fixed128 center_re, Fixed128 center_im,
+								   const double *dcr, const double *dci, int *out, size_t n, int iterations)
+{
+	if (precision == PRECISION_FIXED64)
+		dispatch_kernel()->batch_fixed64(center_re, center_im, dcr, dci, out, n, iterations);
+	else
+		dispatch_kernel()->batch_fixed128(center_re, center_im, dcr, dci, out, n, iterations);
+}
+
+void		mandelbrot_fixed64_batch_scalar(Fixed128 center_re, Fixed128 center_im,
+											const double *dcr, const double *dci, int *out, size_t n, int iterations)
+{
+	for (size_t i = 0; i < n; i++)
+		out[i] = mandelbrot_fixed64(fixed64_offset(center_re, dcr[i]), fixed64_offset(center_im, dci[i]),
+				iterations);
+}
+
+void		mandelbrot_fixed128_batch_scalar(Fixed128 center_re, Fixed128 center_im,
+											 const double *dcr, const double *dci, int *out, size_t n, int iterations)
+{
+	for (size_t i = 0; i < n; i++)
+		out[i] = mandelbrot_fixed128(fixed128_offset(center_re, dcr[i]), fixed128_offset(center_im, dci[i]),
+				iterations);
+}
+
+static t_int128		st_to_int128(Fixed128 a)
+{
+	return (t_int128)((t_uint128)(uint64_t)a.hi << 64 | a.lo);
+}
+
+static Fixed128		st_from_int128(t_int128 a)
+{
+	return (Fixed128){(int64_t)(a >> 64), (uint64_t)a};
+}
+
+static int64_t		st_mul64(int64_t a, int64_t b)
+{
+	uint64_t	magnitude_a = a < 0 ? -(uint64_t)a : (uint64_t)a;
+	uint64_t	magnitude_b = b < 0 ? -(uint64_t)b : (uint64_t)b;
+	int64_t		product = (int64_t)(((t_uint128)magnitude_a * magnitude_b) >> 60);
+
+	return (a < 0) != (b < 0) ? -product : product;
+}
+
+/*
+** The 256 bit product from the 64 bit halves, bits 124 to 251 kept
+*/
+
+static t_int128		st_mul128(t_int128 a, t_int128 b)
+{
+	t_uint128	magnitude_a = a < 0 ? -(t_uint128)a : (t_uint128)a;
+	t_uint128	magnitude_b = b < 0 ? -(t_uint128)b : (t_uint128)b;
+	uint64_t	a0 = (uint64_t)magnitude_a;
+	uint64_t	a1 = (uint64_t)(magnitude_a >> 64);
+	uint64_t	b0 = (uint64_t)magnitude_b;
+	uint64_t	b1 = (uint64_t)(magnitude_b >> 64);
+	t_uint128	low = (t_uint128)a0 * b0;
+	t_uint128	cross_a = (t_uint128)a0 * b1;
+	t_uint128	cross_b = (t_uint128)a1 * b0;
+	t_uint128	middle = (low >> 64) + (uint64_t)cross_a + (uint64_t)cross_b;
+	t_uint128	high = (t_uint128)a1 * b1 + (cross_a >> 64) + (cross_b >> 64) + (middle >> 64);
+	t_int128	product = (t_int128)(high << 4 | (uint64_t)middle >> 60);
+
+	return (a < 0) != (b < 0) ? -product : product;
+}
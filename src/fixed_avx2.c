@@ -0,0 +1,128 @@
+#include "mandel.h"
+
+#ifdef MANDEL_X86
+
+# pragma GCC target("avx2")
+# include <immintrin.h>
+
+# define LANES 4
+
+/*
+** mandelbrot_fixed64() on four lanes. AVX2 only multiplies 32 bit halves
+** so the products are built from the 32 bit halves of the int64.
+** Q4.124 keeps the scalar kernel here: its four limbs per lane made it
+** slower than mandelbrot_fixed128_batch_scalar().
+*/
+
+/*
+** All ones in the negative lanes
+*/
+
+static inline __m256i	st_sign64(__m256i a)
+{
+	return _mm256_cmpgt_epi64(_mm256_setzero_si256(), a);
+}
+
+/*
+** a negated in the lanes of sign
+*/
+
+static inline __m256i	st_negate64(__m256i a, __m256i sign)
+{
+	return _mm256_sub_epi64(_mm256_xor_si256(a, sign), sign);
+}
+
+/*
+** (|a| * |b|) >> 60 with the sign of a * b
+*/
+
+static inline __m256i	st_mul64(__m256i a, __m256i b)
+{
+	const __m256i	low_mask = _mm256_set1_epi64x(0xffffffff);
+	__m256i			sign_a = st_sign64(a);
+	__m256i			sign_b = st_sign64(b);
+	__m256i			magnitude_a = st_negate64(a, sign_a);
+	__m256i			magnitude_b = st_negate64(b, sign_b);
+	__m256i			a1 = _mm256_srli_epi64(magnitude_a, 32);
+	__m256i			b1 = _mm256_srli_epi64(magnitude_b, 32);
+	__m256i			low = _mm256_mul_epu32(magnitude_a, magnitude_b);
+	__m256i			cross_a = _mm256_mul_epu32(magnitude_a, b1);
+	__m256i			cross_b = _mm256_mul_epu32(a1, magnitude_b);
+	__m256i			middle = _mm256_add_epi64(_mm256_add_epi64(_mm256_srli_epi64(low, 32),
+		_mm256_and_si256(cross_a, low_mask)), _mm256_and_si256(cross_b, low_mask));
+	__m256i			high = _mm256_add_epi64(_mm256_add_epi64(_mm256_mul_epu32(a1, b1),
+		_mm256_add_epi64(_mm256_srli_epi64(cross_a, 32), _mm256_srli_epi64(cross_b, 32))),
+		_mm256_srli_epi64(middle, 32));
+	__m256i			product = _mm256_or_si256(_mm256_slli_epi64(high, 4),
+		_mm256_srli_epi64(_mm256_and_si256(middle, low_mask), 28));
+
+	return st_negate64(product, _mm256_xor_si256(sign_a, sign_b));
+}
+
+/*
+** a > b for b >= 0 held in a signed 64 bit lane
+*/
+
+static inline __m256i	st_outside64(__m256i a, __m256i two)
+{
+	return _mm256_or_si256(_mm256_cmpgt_epi64(a, two), _mm256_cmpgt_epi64(_mm256_sub_epi64(_mm256_setzero_si256(),
+		two), a));
+}
+
+void	mandelbrot_fixed64_batch_avx2(Fixed128 center_re, Fixed128 center_im,
+									  const double *dcr, const double *dci, int *out, size_t n, int iterations)
+{
+	const __m256i	two = _mm256_set1_epi64x((int64_t)2 << 60);
+	const __m256i	four = _mm256_set1_epi64x((int64_t)4 << 60);
+	const __m256i	sign_bit = _mm256_set1_epi64x(INT64_MIN);
+	const __m256i	one = _mm256_set1_epi64x(1);
+	size_t			i;
+
+	for (i = 0; i + LANES <= n; i += LANES)
+	{
+		_Alignas(32) int64_t	lane_r[LANES];
+		_Alignas(32) int64_t	lane_i[LANES];
+		_Alignas(32) int64_t	lane_count[LANES];
+
+		for (int lane = 0; lane < LANES; lane++)
+		{
+			lane_r[lane] = fixed64_offset(center_re, dcr[i + lane]);
+			lane_i[lane] = fixed64_offset(center_im, dci[i + lane]);
+		}
+		__m256i	cr = _mm256_load_si256((const __m256i *)lane_r);
+		__m256i	ci = _mm256_load_si256((const __m256i *)lane_i);
+		__m256i	zr = cr;
+		__m256i	zi = ci;
+		__m256i	count = _mm256_setzero_si256();
+		__m256i	active = _mm256_set1_epi64x(-1);
+
+		for (int k = 0; k < iterations; k++)
+		{
+			active = _mm256_andnot_si256(_mm256_or_si256(st_outside64(zr, two), st_outside64(zi, two)), active);
+			if (_mm256_movemask_pd(_mm256_castsi256_pd(active)) == 0)
+				break;
+			__m256i	zr_square = st_mul64(zr, zr);
+			__m256i	zi_square = st_mul64(zi, zi);
+
+			// unsigned sum > 4, the squares are at most 4 in the lanes still active
+			active = _mm256_andnot_si256(_mm256_cmpgt_epi64(
+				_mm256_xor_si256(_mm256_add_epi64(zr_square, zi_square), sign_bit),
+				_mm256_xor_si256(four, sign_bit)), active);
+			if (_mm256_movemask_pd(_mm256_castsi256_pd(active)) == 0)
+				break;
+			count = _mm256_add_epi64(count, _mm256_and_si256(active, one));
+			__m256i	zri = st_mul64(zr, zi);
+
+			zi = _mm256_add_epi64(_mm256_add_epi64(zri, zri), ci);
+			zr = _mm256_add_epi64(_mm256_sub_epi64(zr_square, zi_square), cr);
+		}
+		_mm256_store_si256((__m256i *)lane_count, count);
+		for (int lane = 0; lane < LANES; lane++)
+			out[i + lane] = lane_count[lane];
+	}
+	for (; i < n; i++)
+		out[i] = mandelbrot_fixed64(fixed64_offset(center_re, dcr[i]), fixed64_offset(center_im, dci[i]),
+				iterations);
+}
+
+#endif
@@ -0,0 +1,274 @@
+#include "mandel.h"
+
+#ifdef MANDEL_X86
+
+# pragma GCC target("avx512f")
+# include <immintrin.h>
+
+# define LANES 8
+
+/*
+** mandelbrot_fixed64() and mandelbrot_fixed128() on eight lanes with masks
+** for the lanes. Products are built from 32 bit limbs like
+** mandelbrot_fixed64_batch_avx2(), a Q4.124 is kept as four limbs of 32
+** bits in the low half of 64 bit lanes (least significant first) so their
+** sums have room for the carries.
+*/
+
+typedef struct
+{
+	__m512i	limb[4];
+}			Fixed8;
+
+/*
+** (|a| * |b|) >> 60 with the sign of a * b
+*/
+
+static inline __m512i	st_mul64(__m512i a, __m512i b)
+{
+	const __m512i	low_mask = _mm512_set1_epi64(0xffffffff);
+	__mmask8		negative = _mm512_cmplt_epi64_mask(a, _mm512_setzero_si512())
+		^ _mm512_cmplt_epi64_mask(b, _mm512_setzero_si512());
+	__m512i			magnitude_a = _mm512_abs_epi64(a);
+	__m512i			magnitude_b = _mm512_abs_epi64(b);
+	__m512i			a1 = _mm512_srli_epi64(magnitude_a, 32);
+	__m512i			b1 = _mm512_srli_epi64(magnitude_b, 32);
+	__m512i			low = _mm512_mul_epu32(magnitude_a, magnitude_b);
+	__m512i			cross_a = _mm512_mul_epu32(magnitude_a, b1);
+	__m512i			cross_b = _mm512_mul_epu32(a1, magnitude_b);
+	__m512i			middle = _mm512_add_epi64(_mm512_add_epi64(_mm512_srli_epi64(low, 32),
+		_mm512_and_si512(cross_a, low_mask)), _mm512_and_si512(cross_b, low_mask));
+	__m512i			high = _mm512_add_epi64(_mm512_add_epi64(_mm512_mul_epu32(a1, b1),
+		_mm512_add_epi64(_mm512_srli_epi64(cross_a, 32), _mm512_srli_epi64(cross_b, 32))),
+		_mm512_srli_epi64(middle, 32));
+	__m512i			product = _mm512_or_si512(_mm512_slli_epi64(high, 4),
+		_mm512_srli_epi64(_mm512_and_si512(middle, low_mask), 28));
+
+	return _mm512_mask_sub_epi64(product, negative, _mm512_setzero_si512(), product);
+}
+
+void	mandelbrot_fixed64_batch_avx512(Fixed128 center_re, Fixed128 center_im,
+										const double *dcr, const double *dci, int *out, size_t n, int iterations)
+{
+	const __m512i	two = _mm512_set1_epi64((int64_t)2 << 60);
+	const __m512i	four = _mm512_set1_epi64((int64_t)4 << 60);
+	const __m512i	one = _mm512_set1_epi64(1);
+	size_t			i;
+
+	for (i = 0; i + LANES <= n; i += LANES)
+	{
+		int64_t		lane_r[LANES];
+		int64_t		lane_i[LANES];
+
+		for (int lane = 0; lane < LANES; lane++)
+		{
+			lane_r[lane] = fixed64_offset(center_re, dcr[i + lane]);
+			lane_i[lane] = fixed64_offset(center_im, dci[i + lane]);
+		}
+		__m512i		cr = _mm512_loadu_si512(lane_r);
+		__m512i		ci = _mm512_loadu_si512(lane_i);
+		__m512i		zr = cr;
+		__m512i		zi = ci;
+		__m512i		count = _mm512_setzero_si512();
+		__mmask8	active = 0xff;
+
+		for (int k = 0; k < iterations; k++)
+		{
+			active = _mm512_mask_cmple_epi64_mask(active, _mm512_abs_epi64(zr), two);
+			active = _mm512_mask_cmple_epi64_mask(active, _mm512_abs_epi64(zi), two);
+			if (active == 0)
+				break;
+			__m512i	zr_square = st_mul64(zr, zr);
+			__m512i	zi_square = st_mul64(zi, zi);
+
+			// unsigned sum, the squares are at most 4 in the lanes still active
+			active = _mm512_mask_cmple_epu64_mask(active, _mm512_add_epi64(zr_square, zi_square), four);
+			if (active == 0)
+				break;
+			count = _mm512_mask_add_epi64(count, active, count, one);
+			__m512i	zri = st_mul64(zr, zi);
+
+			zi = _mm512_add_epi64(_mm512_add_epi64(zri, zri), ci);
+			zr = _mm512_add_epi64(_mm512_sub_epi64(zr_square, zi_square), cr);
+		}
+		_mm256_storeu_si256((__m256i *)(out + i), _mm512_cvtepi64_epi32(count));
+	}
+	for (; i < n; i++)
+		out[i] = mandelbrot_fixed64(fixed64_offset(center_re, dcr[i]), fixed64_offset(center_im, dci[i]),
+				iterations);
+}
+
+static inline Fixed8	st_load(const Fixed128 *values)
+{
+	Fixed8	r;
+
+	for (int limb = 0; limb < 4; limb++)
+	{
+		int64_t	lane_limb[LANES];
+
+		for (int lane = 0; lane < LANES; lane++)
+			lane_limb[lane] = (uint32_t)((limb < 2 ? values[lane].lo : (uint64_t)values[lane].hi)
+				>> (limb % 2 * 32));
+		r.limb[limb] = _mm512_loadu_si512(lane_limb);
+	}
+	return r;
+}
+
+/*
+** a + b modulo 2^128
+*/
+
+static inline Fixed8	st_add(Fixed8 a, Fixed8 b)
+{
+	const __m512i	low_mask = _mm512_set1_epi64(0xffffffff);
+	__m512i			carry = _mm512_setzero_si512();
+	Fixed8			r;
+
+	for (int limb = 0; limb < 4; limb++)
+	{
+		__m512i	sum = _mm512_add_epi64(_mm512_add_epi64(a.limb[limb], b.limb[limb]), carry);
+
+		carry = _mm512_srli_epi64(sum, 32);
+		r.limb[limb] = _mm512_and_si512(sum, low_mask);
+	}
+	return r;
+}
+
+/*
+** a negated in the lanes of sign, ~a + 1
+*/
+
+static inline Fixed8	st_negate(Fixed8 a, __mmask8 sign)
+{
+	const __m512i	low_mask = _mm512_set1_epi64(0xffffffff);
+	__m512i			carry = _mm512_maskz_mov_epi64(sign, _mm512_set1_epi64(1));
+	Fixed8			r;
+
+	for (int limb = 0; limb < 4; limb++)
+	{
+		__m512i	sum = _mm512_add_epi64(_mm512_mask_xor_epi64(a.limb[limb], sign, a.limb[limb], low_mask),
+			carry);
+
+		carry = _mm512_srli_epi64(sum, 32);
+		r.limb[limb] = _mm512_and_si512(sum, low_mask);
+	}
+	return r;
+}
+
+static inline __mmask8	st_sign(Fixed8 a)
+{
+	return _mm512_test_epi64_mask(a.limb[3], _mm512_set1_epi64(0x80000000));
+}
+
+/*
+** Magnitude at most bound in the lanes of mask, a bound with only its
+** top limb set
+*/
+
+static inline __mmask8	st_within(__mmask8 mask, Fixed8 a, __m512i bound)
+{
+	__m512i	rest = _mm512_or_si512(_mm512_or_si512(a.limb[0], a.limb[1]), a.limb[2]);
+
+	return _mm512_mask_cmplt_epi64_mask(mask, a.limb[3], bound)
+		| (_mm512_mask_cmpeq_epi64_mask(mask, a.limb[3], bound) & _mm512_testn_epi64_mask(rest, rest));
+}
+
+/*
+** Columns of the 256 bit product of the magnitudes, carried, limbs 124
+** to 251 kept. A square takes its cross products once, doubled.
+*/
+
+static inline Fixed8	st_mul_magnitude(Fixed8 a, Fixed8 b, bool square)
+{
+	const __m512i	low_mask = _mm512_set1_epi64(0xffffffff);
+	__m512i			column[8];
+	__m512i			carry = _mm512_setzero_si512();
+	Fixed8			r;
+
+	for (int k = 0; k < 8; k++)
+		column[k] = _mm512_setzero_si512();
+	for (int x = 0; x < 4; x++)
+	{
+		for (int y = square ? x : 0; y < 4; y++)
+		{
+			__m512i	product = _mm512_mul_epu32(a.limb[x], b.limb[y]);
+			__m512i	low = _mm512_and_si512(product, low_mask);
+			__m512i	high = _mm512_srli_epi64(product, 32);
+
+			if (square && y > x)
+			{
+				low = _mm512_add_epi64(low, low);
+				high = _mm512_add_epi64(high, high);
+			}
+			column[x + y] = _mm512_add_epi64(column[x + y], low);
+			column[x + y + 1] = _mm512_add_epi64(column[x + y + 1], high);
+		}
+	}
+	for (int k = 0; k < 8; k++)
+	{
+		column[k] = _mm512_add_epi64(column[k], carry);
+		carry = _mm512_srli_epi64(column[k], 32);
+		column[k] = _mm512_and_si512(column[k], low_mask);
+	}
+	for (int limb = 0; limb < 4; limb++)
+		r.limb[limb] = _mm512_and_si512(_mm512_or_si512(_mm512_srli_epi64(column[limb + 3], 28),
+			_mm512_slli_epi64(column[limb + 4], 4)), low_mask);
+	return r;
+}
+
+void	mandelbrot_fixed128_batch_avx512(Fixed128 center_re, Fixed128 center_im,
+										 const double *dcr, const double *dci, int *out, size_t n, int iterations)
+{
+	const __m512i	two = _mm512_set1_epi64(2 << 28);
+	const __m512i	four = _mm512_set1_epi64(4 << 28);
+	const __m512i	one = _mm512_set1_epi64(1);
+	size_t			i;
+
+	for (i = 0; i + LANES <= n; i += LANES)
+	{
+		Fixed128	lane_r[LANES];
+		Fixed128	lane_i[LANES];
+
+		for (int lane = 0; lane < LANES; lane++)
+		{
+			lane_r[lane] = fixed128_offset(center_re, dcr[i + lane]);
+			lane_i[lane] = fixed128_offset(center_im, dci[i + lane]);
+		}
+		Fixed8		cr = st_load(lane_r);
+		Fixed8		ci = st_load(lane_i);
+		Fixed8		zr = cr;
+		Fixed8		zi = ci;
+		__m512i		count = _mm512_setzero_si512();
+		__mmask8	active = 0xff;
+
+		for (int k = 0; k < iterations; k++)
+		{
+			__mmask8	sign_r = st_sign(zr);
+			__mmask8	sign_i = st_sign(zi);
+			Fixed8		magnitude_r = st_negate(zr, sign_r);
+			Fixed8		magnitude_i = st_negate(zi, sign_i);
+
+			active = st_within(active, magnitude_r, two);
+			active = st_within(active, magnitude_i, two);
+			if (active == 0)
+				break;
+			Fixed8	zr_square = st_mul_magnitude(magnitude_r, magnitude_r, true);
+			Fixed8	zi_square = st_mul_magnitude(magnitude_i, magnitude_i, true);
+
+			active = st_within(active, st_add(zr_square, zi_square), four);
+			if (active == 0)
+				break;
+			count = _mm512_mask_add_epi64(count, active, count, one);
+			Fixed8	zri = st_negate(st_mul_magnitude(magnitude_r, magnitude_i, false), sign_r ^ sign_i);
+
+			zi = st_add(st_add(zri, zri), ci);
+			zr = st_add(st_add(zr_square, st_negate(zi_square, 0xff)), cr);
+		}
+		_mm256_storeu_si256((__m256i *)(out + i), _mm512_cvtepi64_epi32(count));
+	}
+	for (; i < n; i++)
+		out[i] = mandelbrot_fixed128(fixed128_offset(center_re, dcr[i]), fixed128_offset(center_im, dci[i]),
+				iterations);
+}
+
+#endif
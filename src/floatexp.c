@@ -0,0 +1,86 @@
+#include "mandel.h"
+#include <float.h>
+
+/*
+** Floating point numbers with an int exponent beside the double mantissa,
+** for the values past the range of a double at extreme zooms.
+** The mantissa is kept in [0.5, 1) (or 0) by frexp after every operation.
+*/
+
+#define LOG2_10 3.32192809488736234787
+
+FloatExp	fe_make(double mantissa, int exponent)
+{
+	FloatExp	r;
+	int			shift;
+
+	r.mantissa = frexp(mantissa, &shift);
+	r.exponent = mantissa == 0.0 ? 0 : exponent + shift;
+	return r;
+}
+
+double		fe_to_double(FloatExp a)
+{
+	return ldexp(a.mantissa, a.exponent);
+}
+
+/*
+** strtod notation, the decimal exponent can go past the range of a double
+*/
+
+bool		fe_from_string(FloatExp *r, const char *str)
+{
+	const char	*e = strpbrk(str, "eE");
+	size_t		length = e != NULL ? (size_t)(e - str) : strlen(str);
+	char		mantissa_str[64];
+	char		*end;
+	double		mantissa;
+	long		exponent = 0;
+	double		binary;
+
+	if (length == 0 || length >= sizeof(mantissa_str))
+		return false;
+	memcpy(mantissa_str, str, length);
+	mantissa_str[length] = '\0';
+	mantissa = strtod(mantissa_str, &end);
+	if (*end != '\0' || !isfinite(mantissa))
+		return false;
+	if (e != NULL)
+	{
+		exponent = strtol(e + 1, &end, 10);
+		if (end == e + 1 || *end != '\0' || labs(exponent) > 100000)
+			return false;
+	}
+	binary = floor(exponent * LOG2_10);
+	*r = fe_make(mantissa * exp2(exponent * LOG2_10 - binary), (int)binary);
+	return true;
+}
+
+FloatExp	fe_add(FloatExp a, FloatExp b)
+{
+	if (b.mantissa == 0.0)
+		return a;
+	if (a.mantissa == 0.0)
+		return b;
+	if (a.exponent < b.exponent)
+		return fe_add(b, a);
+	if (a.exponent - b.exponent > DBL_MANT_DIG + 1)
+		return a;
+	return fe_make(a.mantissa + ldexp(b.mantissa, b.exponent - a.exponent), a.exponent);
+}
+
+FloatExp	fe_sub(FloatExp a, FloatExp b)
+{
+	b.mantissa = -b.mantissa;
+	return fe_add(a, b);
+}
+
+FloatExp	fe_mul(FloatExp a, FloatExp b)
+{
+	return fe_make(a.mantissa * b.mantissa, a.exponent + b.exponent);
+}
+
+FloatExp	fe_mul_double(FloatExp a, double b)
+{
+	return fe_make(a.mantissa * b, a.exponent);
+}
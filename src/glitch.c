@@ -0,0 +1,201 @@
+#include "mandel.h"
+#include "config.h"
+
+#define CHUNK 1024
+
+/*
+** Buffers of a chunk of a group, one per worker of the pool
+*/
+
+typedef struct
+{
+	double			dcr[CHUNK];
+	double			dci[CHUNK];
+	int				out[CHUNK];
+	bool			glitched[CHUNK];
+}					Chunk;
+
+/*
+** Pixels of one glitched group re-rendered against a secondary reference
+*/
+
+typedef struct
+{
+	const Reference	*reference;
+	const int		*members;
+	int				count;
+	int				width;
+	Point			origin;
+	Point			step;
+	int				*counts;
+	unsigned char	*status;
+	int				iterations;
+	Chunk			*chunks;
+}					GlitchJob;
+
+static int	st_groups(const State *state, const int *counts, const unsigned char *status,
+						bool *visited, int *members, int *starts);
+static bool	st_correct(State *state, GlitchJob *job, Point origin, Point step);
+static void	st_render_chunk(void *arg, int worker, int task);
+
+/*
+** Pixels flagged by the Pauldelbrot criterion (PIXEL_GLITCHED) are flooded
+** into 4-connected groups, with the filled pixels of the same count next
+** to them since a glitch is usually a flat blob. Each group is rendered
+** again against a secondary reference taken at the glitched pixel closest
+** to its centroid, whose own delta is zero so it never glitches. Pixels
+** still glitched form the groups of the next pass, until none is left or
+** MANDEL_GLITCH_REFERENCES references were used.
+** origin and step map a pixel to its offset from the center, scaled like
+** the offsets perturbation takes. Returns false when an allocation failed.
+*/
+
+bool		glitch_correct(State *state, int *counts, unsigned char *status,
+							Point origin, Point step, RenderStats *stats)
+{
+	size_t		area = (size_t)state->width * state->height;
+	bool		*visited = malloc(sizeof(bool) * area);
+	int			*members = malloc(sizeof(int) * area);
+	int			*starts = malloc(sizeof(int) * (area + 1));
+	GlitchJob	job;
+	int			groups;
+	bool		ok;
+
+	job.chunks = malloc(sizeof(Chunk) * state->pool.size);
+	ok = visited != NULL && members != NULL && starts != NULL && job.chunks != NULL;
+	job.width = state->width;
+	job.origin = origin;
+	job.step = step;
+	job.counts = counts;
+	job.status = status;
+	job.iterations = state->iterations;
+	while (ok && stats->references < MANDEL_GLITCH_REFERENCES
+		&& (groups = st_groups(state, counts, status, visited, members, starts)) > 0)
+	{
+		for (int g = 0; ok && g < groups && stats->references < MANDEL_GLITCH_REFERENCES; g++)
+		{
+			job.members = members + starts[g];
+			job.count = starts[g + 1] - starts[g];
+			ok = st_correct(state, &job, origin, step);
+			stats->references++;
+			stats->corrected += job.count;
+		}
+	}
+	free(visited);
+	free(members);
+	free(starts);
+	free(job.chunks);
+	return ok;
+}
+
+/*
+** Groups are stored one after the other in members, group g being
+** members[starts[g]] to members[starts[g + 1] - 1].
+*/
+
+static int	st_groups(const State *state, const int *counts, const unsigned char *status,
+						bool *visited, int *members, int *starts)
+{
+	int		width = state->width;
+	int		height = state->height;
+	int		groups = 0;
+	int		end = 0;
+
+	memset(visited, 0, sizeof(bool) * width * height);
+	for (int seed = 0; seed < width * height; seed++)
+	{
+		int		head = end;
+
+		if (status[seed] != PIXEL_GLITCHED || visited[seed])
+			continue ;
+		starts[groups++] = end;
+		visited[seed] = true;
+		members[end++] = seed;
+		for (; head < end; head++)
+		{
+			int		p = members[head];
+			int		x = p % width;
+			int		y = p / width;
+			int		neighbors[4] = {x > 0 ? p - 1 : -1, x < width - 1 ? p + 1 : -1,
+									y > 0 ? p - width : -1, y < height - 1 ? p + width : -1};
+
+			for (int k = 0; k < 4; k++)
+			{
+				int	q = neighbors[k];
+
+				if (q < 0 || visited[q] || (status[q] != PIXEL_GLITCHED
+					&& (status[q] != PIXEL_FILLED || counts[q] != counts[p])))
+					continue ;
+				visited[q] = true;
+				members[end++] = q;
+			}
+		}
+	}
+	starts[groups] = end;
+	return groups;
+}
+
+static bool	st_correct(State *state, GlitchJob *job, Point origin, Point step)
+{
+	Reference	reference;
+	Point		centroid = {0.0, 0.0};
+	Point		offset;
+	int			best = -1;
+	double		best_distance = INFINITY;
+	bool		ok;
+
+	for (int i = 0; i < job->count; i++)
+	{
+		centroid.x += job->members[i] % job->width;
+		centroid.y += job->members[i] / job->width;
+	}
+	centroid.x /= job->count;
+	centroid.y /= job->count;
+	for (int i = 0; i < job->count; i++)
+	{
+		double	dx = job->members[i] % job->width - centroid.x;
+		double	dy = job->members[i] / job->width - centroid.y;
+
+		if (job->status[job->members[i]] == PIXEL_GLITCHED && dx * dx + dy * dy < best_distance)
+		{
+			best = job->members[i];
+			best_distance = dx * dx + dy * dy;
+		}
+	}
+	offset.x = origin.x + (best % job->width + 0.5) * step.x;
+	offset.y = origin.y + (best / job->width + 0.5) * step.y;
+	memset(&reference, 0, sizeof(Reference));
+	ok = perturbation_prepare(&reference, state, offset);
+	// the group is rendered from the reference pixel
+	job->origin.x = origin.x - offset.x;
+	job->origin.y = origin.y - offset.y;
+	job->reference = &reference;
+	ok = ok && pool_run(&state->pool, (job->count + CHUNK - 1) / CHUNK, st_render_chunk, job);
+	perturbation_free(&reference);
+	return ok;
+}
+
+static void	st_render_chunk(void *arg, int worker, int task)
+{
+	GlitchJob	*job = arg;
+	int			start = task * CHUNK;
+	int			count = MIN(CHUNK, job->count - start);
+	Chunk		*chunk = &job->chunks[worker];
+
+	if (count <= 0)
+		return ;
+	for (int i = 0; i < count; i++)
+	{
+		int	p = job->members[start + i];
+
+		chunk->dcr[i] = job->origin.x + (p % job->width + 0.5) * job->step.x;
+		chunk->dci[i] = job->origin.y + (p / job->width + 0.5) * job->step.y;
+	}
+	perturbation_batch(job->reference, chunk->dcr, chunk->dci, chunk->out, chunk->glitched,
+			count, job->iterations);
+	for (int i = 0; i < count; i++)
+	{
+		job->counts[job->members[start + i]] = chunk->out[i];
+		job->status[job->members[start + i]] = chunk->glitched[i] ? PIXEL_GLITCHED : PIXEL_COMPUTED;
+	}
+}
@@ -0,0 +1,342 @@
+#include "mandel.h"
+#include "config.h"
+#include <time.h>
+
+typedef struct
+{
+	const char	*filepath;
+	bool		stats;
+	bool		benchmark;
+	bool		period_color;
+	const char	*center_real;
+	const char	*center_imag;
+	FloatExp	radius;
+}				Options;
+
+static bool	st_parse(State *state, Options *options, int argc, char **argv);
+static bool	st_parse_view(State *state, const Options *options);
+static bool	st_benchmark(State *state, int *counts);
+static bool	st_parse_double(const char *str, double *value);
+static bool	st_parse_int(const char *str, int *value);
+static void	st_usage(void);
+
+/*
+** mandel --render FILE [--view RE_START RE_END IM_START IM_END]
+**                      [--size WIDTHxHEIGHT] [--iterations N]
+**                      [--center RE IM] [--radius R]
+**                      [--period-tolerance T] [--period-color]
+**                      [--mode brute|subdivide|trace]
+**                      [--precision auto|float|double|double-double|fixed64|fixed128
+**                                   |perturbation]
+**                      [--no-rebase] [--reference-grid N] [--orbit-float]
+**                      [--orbit-cache DIR] [--orbit-cache-limit MIB] [--stats]
+**                      [--benchmark]
+** Render on the CPU and write a PPM image, without touching SDL or OpenGL.
+** The precision defaults to auto, the cheapest accurate for the zoom.
+** The center is parsed in full precision, the radius is half the
+** imaginary span and may go past the range of a double, both override
+** --view. --reference-grid N adds a reference in each cell of an N * N
+** grid (up to MANDEL_REFERENCE_GRID_MAX) for wide perturbation frames,
+** --orbit-float stores their orbits as floats when not rebased.
+** --orbit-cache keeps the orbits in DIR for the next renders, the least
+** recently used going past MIB (MANDEL_ORBIT_CACHE_LIMIT by default).
+** --period-color colors the inside of the set by the period of its
+** cycle where the number type detects it (double and float).
+** --benchmark first times the view in double-double and both fixed point
+** formats, see st_benchmark(). Fixed point, forced or benchmarked, needs
+** the view within [-4, 4) on both axes (fixed_supported).
+*/
+
+int			headless_render(int argc, char **argv)
+{
+	State		state;
+	Options		options;
+	RenderStats	stats;
+	int			*counts;
+	int			*periods;
+	int			status;
+
+	memset(&state, 0, sizeof(State));
+	state.width = MANDEL_WINDOW_WIDTH;
+	state.height = MANDEL_WINDOW_HEIGHT;
+	state.iterations = MANDEL_ITERATIONS;
+	state.period_tolerance = MANDEL_PERIOD_TOLERANCE;
+	state.precision = PRECISION_AUTO;
+	state.rebase = true;
+	state.reference_grid = 1;
+	state.orbit_cache.limit = MANDEL_ORBIT_CACHE_LIMIT;
+	state.real_start = -2.0;
+	state.real_end = 2.0;
+	state.imag_start = -2.0;
+	state.imag_end = 2.0;
+	memset(&options, 0, sizeof(Options));
+	if (!st_parse(&state, &options, argc, argv) || !st_parse_view(&state, &options))
+	{
+		st_usage();
+		return EXIT_FAILURE;
+	}
+	periods = NULL;
+	if ((counts = malloc(sizeof(int) * state.width * state.height)) == NULL
+		|| (options.period_color && (periods = malloc(sizeof(int) * state.width * state.height)) == NULL))
+	{
+		free(counts);
+		perror(NULL);
+		return EXIT_FAILURE;
+	}
+	if (!pool_init(&state.pool, 0))
+	{
+		free(counts);
+		free(periods);
+		perror(NULL);
+		return EXIT_FAILURE;
+	}
+	status = EXIT_SUCCESS;
+	if ((options.benchmark && !st_benchmark(&state, counts))
+		|| !render_cpu(&state, counts, periods, &stats)
+		|| !image_write_ppm(options.filepath, counts, periods, state.width, state.height, state.iterations))
+	{
+		perror(options.filepath);
+		status = EXIT_FAILURE;
+	}
+	else if (options.stats)
+	{
+		fprintf(stderr, "%ld pixels computed, %ld filled (%.1f%% computed)\n",
+				stats.computed, stats.filled,
+				100.0 * stats.computed / ((double)state.width * state.height));
+		fprintf(stderr, "rendered in %s\n", precision_name(stats.precision));
+		if (stats.precision == PRECISION_DOUBLE || stats.precision == PRECISION_FLOAT)
+			fprintf(stderr, "%s kernel, interleave %d\n",
+					dispatch_kernel()->name, dispatch_interleave());
+		if (stats.precision == PRECISION_PERTURBATION)
+		{
+			fprintf(stderr, "reference orbit of %d iterations at %d bits (%zu KiB of %s%s), series skipped %d\n",
+					state.references[0].orbit.length - 1, 32 * (state.references[0].orbit.precision - 1),
+					state.references[0].orbit.size >> 10,
+					state.references[0].orbit.compressed ? "floats" : "doubles",
+					state.references[0].orbit.cached ? ", cached" : "",
+					state.references[0].series.skip);
+			for (int i = 1; i < state.references_count; i++)
+				fprintf(stderr, "grid reference orbit of %d iterations\n",
+						state.references[i].orbit.length - 1);
+			fprintf(stderr, "%ld glitched pixels rendered again with %d references\n",
+					stats.corrected, stats.references);
+		}
+	}
+	pool_quit(&state.pool);
+	references_free(&state);
+	free(counts);
+	free(periods);
+	return status;
+}
+
+static bool	st_parse(State *state, Options *options, int argc, char **argv)
+{
+	int		i;
+	int		limit;
+
+	if (argc < 3)
+		return false;
+	options->filepath = argv[2];
+	for (i = 3; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--view") == 0 && i + 4 < argc)
+		{
+			if (!st_parse_double(argv[++i], &state->real_start)
+				|| !st_parse_double(argv[++i], &state->real_end)
+				|| !st_parse_double(argv[++i], &state->imag_start)
+				|| !st_parse_double(argv[++i], &state->imag_end))
+				return false;
+		}
+		else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc)
+		{
+			if (sscanf(argv[++i], "%dx%d", &state->width, &state->height) != 2
+				|| state->width <= 0 || state->height <= 0)
+				return false;
+		}
+		else if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc)
+		{
+			if (!st_parse_int(argv[++i], &state->iterations) || state->iterations <= 0)
+				return false;
+		}
+		else if (strcmp(argv[i], "--period-tolerance") == 0 && i + 1 < argc)
+		{
+			if (!st_parse_double(argv[++i], &state->period_tolerance))
+				return false;
+		}
+		else if (strcmp(argv[i], "--mode") == 0 && i + 1 < argc)
+		{
+			i++;
+			if (strcmp(argv[i], "brute") == 0)
+				state->render_mode = RENDER_BRUTE;
+			else if (strcmp(argv[i], "subdivide") == 0)
+				state->render_mode = RENDER_SUBDIVIDE;
+			else if (strcmp(argv[i], "trace") == 0)
+				state->render_mode = RENDER_TRACE;
+			else
+				return false;
+		}
+		else if (strcmp(argv[i], "--center") == 0 && i + 2 < argc)
+		{
+			options->center_real = argv[++i];
+			options->center_imag = argv[++i];
+		}
+		else if (strcmp(argv[i], "--radius") == 0 && i + 1 < argc)
+		{
+			if (!fe_from_string(&options->radius, argv[++i]) || options->radius.mantissa <= 0.0)
+				return false;
+		}
+		else if (strcmp(argv[i], "--precision") == 0 && i + 1 < argc)
+		{
+			i++;
+			if (strcmp(argv[i], "auto") == 0)
+				state->precision = PRECISION_AUTO;
+			else if (strcmp(argv[i], "float") == 0)
+				state->precision = PRECISION_FLOAT;
+			else if (strcmp(argv[i], "double") == 0)
+				state->precision = PRECISION_DOUBLE;
+			else if (strcmp(argv[i], "double-double") == 0)
+				state->precision = PRECISION_DOUBLE_DOUBLE;
+			else if (strcmp(argv[i], "fixed64") == 0)
+				state->precision = PRECISION_FIXED64;
+			else if (strcmp(argv[i], "fixed128") == 0)
+				state->precision = PRECISION_FIXED128;
+			else if (strcmp(argv[i], "perturbation") == 0)
+				state->precision = PRECISION_PERTURBATION;
+			else
+				return false;
+		}
+		else if (strcmp(argv[i], "--no-rebase") == 0)
+			state->rebase = false;
+		else if (strcmp(argv[i], "--reference-grid") == 0 && i + 1 < argc)
+		{
+			if (!st_parse_int(argv[++i], &state->reference_grid) || state->reference_grid <= 0
+				|| state->reference_grid > MANDEL_REFERENCE_GRID_MAX)
+				return false;
+		}
+		else if (strcmp(argv[i], "--orbit-float") == 0)
+			state->orbit_float = true;
+		else if (strcmp(argv[i], "--orbit-cache") == 0 && i + 1 < argc)
+			state->orbit_cache.directory = argv[++i];
+		else if (strcmp(argv[i], "--orbit-cache-limit") == 0 && i + 1 < argc)
+		{
+			if (!st_parse_int(argv[++i], &limit) || limit <= 0)
+				return false;
+			state->orbit_cache.limit = (size_t)limit << 20;
+		}
+		else if (strcmp(argv[i], "--stats") == 0)
+			options->stats = true;
+		else if (strcmp(argv[i], "--benchmark") == 0)
+			options->benchmark = true;
+		else if (strcmp(argv[i], "--period-color") == 0)
+			options->period_color = true;
+		else
+			return false;
+	}
+	return state->real_start < state->real_end && state->imag_start < state->imag_end;
+}
+
+static bool	st_parse_view(State *state, const Options *options)
+{
+	view_from_bounds(state);
+	if (options->center_real != NULL
+		&& (!big_from_string(&state->center_real, options->center_real)
+			|| !big_from_string(&state->center_imag, options->center_imag)))
+		return false;
+	if (options->radius.mantissa > 0.0)
+	{
+		state->radius_imag = options->radius.mantissa;
+		state->radius_real = state->radius_imag * state->width / state->height;
+		state->radius_exponent = options->radius.exponent;
+		view_normalize(state);
+		if (!orbit_supported(fe_make(MIN(state->radius_real, state->radius_imag), state->radius_exponent)))
+		{
+			fprintf(stderr, "radius past the %d bits of a reference orbit\n", 32 * (MANDEL_BIG_LIMBS - 1));
+			return false;
+		}
+	}
+	if (options->center_real != NULL || options->radius.mantissa > 0.0)
+		view_to_bounds(state);
+	if ((state->precision == PRECISION_FIXED64 || state->precision == PRECISION_FIXED128
+			|| options->benchmark) && !fixed_supported(state))
+	{
+		fprintf(stderr, "view past the [-4, 4) range of fixed point\n");
+		return false;
+	}
+	return true;
+}
+
+/*
+** Time of the view in double-double, Q4.60 and Q4.124 with the kernel
+** of the cpu, best of MANDEL_BENCHMARK_RUNS, and how many pixels the
+** fixed point counts change from the double-double ones, to weigh them
+** against each other on the rungs of the precision ladder.
+*/
+
+static bool	st_benchmark(State *state, int *counts)
+{
+	static const int	precisions[] = {PRECISION_DOUBLE_DOUBLE, PRECISION_FIXED64, PRECISION_FIXED128};
+	int					saved = state->precision;
+	int					*reference;
+	struct timespec		start;
+	struct timespec		end;
+	bool				ok = true;
+
+	if ((reference = malloc(sizeof(int) * state->width * state->height)) == NULL)
+		return false;
+	fprintf(stderr, "%s kernel, %dx%d, %d iterations\n", dispatch_kernel()->name,
+			state->width, state->height, state->iterations);
+	for (size_t p = 0; ok && p < sizeof(precisions) / sizeof(int); p++)
+	{
+		double	best = INFINITY;
+		long	different = 0;
+
+		state->precision = precisions[p];
+		for (int run = 0; ok && run < MANDEL_BENCHMARK_RUNS; run++)
+		{
+			clock_gettime(CLOCK_MONOTONIC, &start);
+			ok = render_cpu(state, p == 0 ? reference : counts, NULL, NULL);
+			clock_gettime(CLOCK_MONOTONIC, &end);
+			best = MIN(best, (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9);
+		}
+		for (int i = 0; ok && p > 0 && i < state->width * state->height; i++)
+			different += counts[i] != reference[i];
+		if (ok)
+			fprintf(stderr, "%-14s %8.3f s, %ld pixels differ from double-double\n",
+					precision_name(precisions[p]), best, different);
+	}
+	state->precision = saved;
+	free(reference);
+	return ok;
+}
+
+static bool	st_parse_double(const char *str, double *value)
+{
+	char	*end;
+
+	*value = strtod(str, &end);
+	return *str != '\0' && *end == '\0' && isfinite(*value);
+}
+
+static bool	st_parse_int(const char *str, int *value)
+{
+	char	*end;
+	long	n;
+
+	n = strtol(str, &end, 10);
+	*value = n;
+	return *str != '\0' && *end == '\0' && n >= INT_MIN && n <= INT_MAX;
+}
+
+static void	st_usage(void)
+{
+	fputs("usage: mandel --render FILE [--view RE_START RE_END IM_START IM_END]\n"
+		  "                            [--size WIDTHxHEIGHT] [--iterations N]\n"
+		  "                            [--center RE IM] [--radius R]\n"
+		  "                            [--period-tolerance T] [--period-color]\n"
+		  "                            [--mode brute|subdivide|trace]\n"
+		  "                            [--precision auto|float|double|double-double|fixed64|fixed128\n"
+		  "                                         |perturbation]\n"
+		  "                            [--no-rebase] [--reference-grid N] [--orbit-float]\n"
+		  "                            [--orbit-cache DIR] [--orbit-cache-limit MIB] [--stats]\n"
+		  "                            [--benchmark]\n", stderr);
+}
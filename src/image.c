@@ -0,0 +1,66 @@
+#include "mandel.h"
+
+#define MANDEL_PALETTE_SIZE 1024
+#define PERIOD_STEP 0.6180339887
+
+static Color	st_period_color(const Color *palette, int period);
+
+/*
+** Binary PPM, top row first, colored like the shader:
+** palette lookup on count / iterations and black inside the set, or the
+** color of its period when periods (optional) has one.
+*/
+
+bool	image_write_ppm(const char *filepath, const int *counts, const int *periods, int width, int height,
+						int iterations)
+{
+	FILE	*file;
+	Color	*palette;
+	uint8_t	*row;
+	bool	ok;
+
+	if ((palette = color_palette_new(MANDEL_PALETTE_SIZE)) == NULL)
+		return false;
+	if ((row = malloc(sizeof(uint8_t) * 3 * width)) == NULL
+		|| (file = fopen(filepath, "wb")) == NULL)
+	{
+		free(row);
+		free(palette);
+		return false;
+	}
+	ok = fprintf(file, "P6\n%d %d\n255\n", width, height) > 0;
+	for (int y = height - 1; ok && y >= 0; y--)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			int		n = counts[y * width + x];
+			Color	color = {0, 0, 0};
+
+			if (n < iterations)
+				color = palette[(long)n * MANDEL_PALETTE_SIZE / iterations];
+			else if (periods != NULL && periods[y * width + x] > 0)
+				color = st_period_color(palette, periods[y * width + x]);
+			row[3 * x] = color.r;
+			row[3 * x + 1] = color.g;
+			row[3 * x + 2] = color.b;
+		}
+		ok = fwrite(row, sizeof(uint8_t), 3 * width, file) == (size_t)(3 * width);
+	}
+	ok = fclose(file) == 0 && ok;
+	free(row);
+	free(palette);
+	return ok;
+}
+
+/*
+** The palette at the period times the golden ratio, so that close periods
+** get far apart colors, at half brightness like mandelbrot_color() in the
+** shaders
+*/
+
+static Color	st_period_color(const Color *palette, int period)
+{
+	Color	color = palette[(long)(fmod(period * PERIOD_STEP, 1.0) * MANDEL_PALETTE_SIZE)];
+
+	return (Color){.r = color.r / 2, .g = color.g / 2, .b = color.b / 2};
+}
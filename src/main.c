@@ -1,9 +1,12 @@
 #include "mandel.h"
 
-int main(void)
+int main(int argc, char **argv)
 {
     State state;
 
+	dispatch_init();
+	if (argc > 1 && strcmp(argv[1], "--render") == 0)
+		return headless_render(argc, argv);
 	if (!state_init(&state))
 		return (1);
     state_run(&state);
@@ -1,13 +1,78 @@
 #include "mandel.h"
+#include "config.h"
 
-int mandelbrot(double ca, double cb, int iterations)
+/*
+** Slot of the interleaved scalar kernel, iterating the pixels from next
+** to end one after the other
+*/
+
+typedef struct
+{
+    double	cr;
+    double	ci;
+    double	zr;
+    double	zi;
+    double	saved_zr;
+    double	saved_zi;
+    int		count;
+    int		cycle;
+    int		cycle_limit;
+    bool	active;
+    size_t	index;
+    size_t	next;
+    size_t	end;
+}			Slot;
+
+static inline bool	st_block(double ca, double cb, int n, double tolerance,
+							 double *zr, double *zi, double *saved_zr, double *saved_zi);
+static Slot			st_start(size_t next, size_t end);
+static int			st_period(double ca, double cb, double zr, double zi, int cycle, double tolerance);
+static inline void	st_advance(Slot *slot, const double *re, const double *im, int *out, int iterations,
+								double tolerance);
+
+/*
+** Closed-form tests for the main cardioid and the period-2 bulb,
+** every point inside them never escapes.
+*/
+
+static bool st_interior(double ca, double cb)
+{
+    double	x = ca - 0.25;
+    double	y_square = cb * cb;
+    double	q = x * x + y_square;
+
+    if (q * (q + x) <= 0.25 * y_square)
+        return true;
+    return (ca + 1.0) * (ca + 1.0) + y_square <= 0.0625;
+}
+
+/*
+** Brent cycle detection: z is saved every power of two iterations,
+** an orbit coming back within tolerance of the saved point is periodic
+** and never escapes. The period goes to *period (0 when unknown, see
+** st_period), a negative tolerance disables the detection.
+*/
+
+int mandelbrot(double ca, double cb, int iterations, double tolerance, int *period)
 {
     double	zr = ca;
     double	zi = cb;
     double	zr_square;
     double	zi_square;
+    double	saved_zr = zr;
+    double	saved_zi = zi;
+    int		cycle = 0;
+    int		cycle_limit = 1;
     int		n;
 
+    if (period != NULL)
+        *period = 0;
+    if (st_interior(ca, cb))
+    {
+        if (period != NULL)
+            *period = ca < -0.75 ? 2 : 1;
+        return iterations;
+    }
     for (n = 0; n < iterations; n++)
     {
         zi_square = zi * zi;
@@ -18,6 +83,300 @@ int mandelbrot(double ca, double cb, int iterations)
         zr = zr_square - zi_square;
         zi += cb;
         zr += ca;
+
+        cycle++;
+        if (fabs(zr - saved_zr) <= tolerance && fabs(zi - saved_zi) <= tolerance)
+        {
+            if (period != NULL)
+                *period = st_period(ca, cb, zr, zi, cycle, tolerance);
+            return iterations;
+        }
+        if (cycle == cycle_limit)
+        {
+            cycle = 0;
+            cycle_limit *= 2;
+            saved_zr = zr;
+            saved_zi = zi;
+        }
     }
     return n;
 }
+
+/*
+** The cycle met is a multiple of the period when the saved point was not
+** yet close to the attracting cycle. z now is, its first return is the
+** period: within the square root of the tolerance as a slow orbit may
+** still be converging while the points of a cycle are far apart.
+*/
+
+static int	st_period(double ca, double cb, double zr, double zi, int cycle, double tolerance)
+{
+    double	wr = zr;
+    double	wi = zi;
+    double	wr_square;
+    double	wi_square;
+
+    for (int k = 1; k < cycle; k++)
+    {
+        wi_square = wi * wi;
+        wr_square = wr * wr;
+        wi = 2.0 * wr * wi;
+        wr = wr_square - wi_square;
+        wi += cb;
+        wr += ca;
+        if (fabs(wr - zr) <= sqrt(tolerance) && fabs(wi - zi) <= sqrt(tolerance))
+            return k;
+    }
+    return cycle;
+}
+
+/*
+** mandelbrot() testing for escape and cycles once per block of
+** MANDEL_ESCAPE_UNROLL iterations (st_block), a block that escaped or met
+** a cycle is replayed one iteration at a time so the count is the one of
+** mandelbrot()
+*/
+
+int mandelbrot_unrolled(double ca, double cb, int iterations, double tolerance)
+{
+    double	zr = ca;
+    double	zi = cb;
+    double	zr_square;
+    double	zi_square;
+    double	saved_zr = zr;
+    double	saved_zi = zi;
+    int		n = 0;
+
+    if (st_interior(ca, cb))
+        return iterations;
+    while (n + MANDEL_ESCAPE_UNROLL <= iterations
+        && st_block(ca, cb, n, tolerance, &zr, &zi, &saved_zr, &saved_zi))
+        n += MANDEL_ESCAPE_UNROLL;
+    for (; n < iterations; n++)
+    {
+        zi_square = zi * zi;
+        zr_square = zr * zr;
+        if (zr_square + zi_square > 4.0)
+            return n;
+        zi = 2.0 * zr * zi;
+        zr = zr_square - zi_square;
+        zi += cb;
+        zr += ca;
+        if (fabs(zr - saved_zr) <= tolerance && fabs(zi - saved_zi) <= tolerance)
+            return iterations;
+        if (((n + 1) & (n + 2)) == 0)
+        {
+            saved_zr = zr;
+            saved_zi = zi;
+        }
+    }
+    return n;
+}
+
+/*
+** MANDEL_ESCAPE_UNROLL iterations from count n without a branch, false
+** and z left as it was if the block escaped or came back within tolerance
+** of the saved z. A |z| past 2 (with |c| at most 2, else z0 escapes) only
+** grows so the test at the end sees any escape inside the block, !(<= 4)
+** also catching the inf and NaN of a blown up z. The closest return to
+** the saved z is kept instead of testing each one, a NaN distance can
+** only make it replay for nothing. The saves of the Brent schedule come
+** after 1, 3, 7... iterations (count + 1 a power of two) so in blocks of
+** a power of two only at their steps k + 1 a power of two.
+*/
+
+static inline bool	st_block(double ca, double cb, int n, double tolerance,
+							 double *zr, double *zi, double *saved_zr, double *saved_zi)
+{
+    double	block_zr = *zr;
+    double	block_zi = *zi;
+    double	block_saved_zr = *saved_zr;
+    double	block_saved_zi = *saved_zi;
+    double	closest = INFINITY;
+
+    for (int k = 1; k <= MANDEL_ESCAPE_UNROLL; k++)
+    {
+        double	zr_square = block_zr * block_zr;
+        double	zi_square = block_zi * block_zi;
+        double	distance_r;
+        double	distance_i;
+
+        block_zi = 2.0 * block_zr * block_zi;
+        block_zr = zr_square - zi_square;
+        block_zi += cb;
+        block_zr += ca;
+        distance_r = fabs(block_zr - block_saved_zr);
+        distance_i = fabs(block_zi - block_saved_zi);
+        distance_r = distance_r > distance_i ? distance_r : distance_i;
+        closest = distance_r < closest ? distance_r : closest;
+        if ((k & (k + 1)) == 0 && ((n + k) & (n + k + 1)) == 0)
+        {
+            block_saved_zr = block_zr;
+            block_saved_zi = block_zi;
+        }
+    }
+    if (closest <= tolerance || !(block_zr * block_zr + block_zi * block_zi <= 4.0))
+        return false;
+    *zr = block_zr;
+    *zi = block_zi;
+    *saved_zr = block_saved_zr;
+    *saved_zi = block_saved_zi;
+    return true;
+}
+
+/*
+** period (optional) receives the period of every pixel like mandelbrot(),
+** the SIMD kernels only keep the count so asking for it runs mandelbrot()
+** pixel after pixel, which gives the same counts
+*/
+
+void mandelbrot_batch(const double *re, const double *im, int *out, int *period, size_t n, int iterations,
+                      double tolerance)
+{
+    if (period != NULL)
+        for (size_t i = 0; i < n; i++)
+            out[i] = mandelbrot(re[i], im[i], iterations, tolerance, &period[i]);
+    else
+        dispatch_kernel()->batch(re, im, out, n, iterations, tolerance, dispatch_interleave());
+}
+
+/*
+** mandelbrot_unrolled() pixel after pixel, the interleave is ignored
+*/
+
+void mandelbrot_batch_unrolled(const double *re, const double *im, int *out, size_t n, int iterations,
+                               double tolerance, int interleave)
+{
+    (void)interleave;
+    for (size_t i = 0; i < n; i++)
+        out[i] = mandelbrot_unrolled(re[i], im[i], iterations, tolerance);
+}
+
+/*
+** mandelbrot() pixel after pixel, or with interleave 2 or 4 that many
+** pixels advanced in the same loop so their independent iterations fill
+** the latency of each other's multiply and add chain
+*/
+
+void mandelbrot_batch_scalar(const double *re, const double *im, int *out, size_t n, int iterations,
+                             double tolerance, int interleave)
+{
+    Slot	a;
+    Slot	b;
+    Slot	c;
+    Slot	d;
+
+    if (interleave >= 4)
+    {
+        a = st_start(0, n / 4);
+        b = st_start(n / 4, n / 2);
+        c = st_start(n / 2, 3 * n / 4);
+        d = st_start(3 * n / 4, n);
+        while (a.active || b.active || c.active || d.active)
+        {
+            st_advance(&a, re, im, out, iterations, tolerance);
+            st_advance(&b, re, im, out, iterations, tolerance);
+            st_advance(&c, re, im, out, iterations, tolerance);
+            st_advance(&d, re, im, out, iterations, tolerance);
+        }
+    }
+    else if (interleave == 2)
+    {
+        a = st_start(0, n / 2);
+        b = st_start(n / 2, n);
+        while (a.active || b.active)
+        {
+            st_advance(&a, re, im, out, iterations, tolerance);
+            st_advance(&b, re, im, out, iterations, tolerance);
+        }
+    }
+    else
+        for (size_t i = 0; i < n; i++)
+            out[i] = mandelbrot(re[i], im[i], iterations, tolerance, NULL);
+}
+
+/*
+** A slot stays active until its range is done, like the lanes of the
+** SIMD kernels it takes the next pixel as soon as one is done
+*/
+
+static Slot			st_start(size_t next, size_t end)
+{
+    Slot	slot;
+
+    slot.active = true;
+    slot.next = next;
+    slot.end = end;
+    slot.index = next;
+    slot.cr = 0.0;
+    slot.ci = 0.0;
+    slot.zr = 0.0;
+    slot.zi = 0.0;
+    slot.saved_zr = 0.0;
+    slot.saved_zi = 0.0;
+    slot.cycle = 0;
+    slot.cycle_limit = 1;
+    slot.count = -1;
+    return slot;
+}
+
+/*
+** One iteration of mandelbrot(), a count of -1 takes the next pixel
+*/
+
+static inline void	st_advance(Slot *slot, const double *re, const double *im, int *out, int iterations,
+								double tolerance)
+{
+    double	zr_square;
+    double	zi_square;
+
+    if (!slot->active)
+        return ;
+    if (slot->count < 0)
+    {
+        while (slot->next < slot->end && st_interior(re[slot->next], im[slot->next]))
+            out[slot->next++] = iterations;
+        if (slot->next == slot->end)
+        {
+            slot->active = false;
+            return ;
+        }
+        slot->index = slot->next++;
+        slot->cr = re[slot->index];
+        slot->ci = im[slot->index];
+        slot->zr = slot->cr;
+        slot->zi = slot->ci;
+        slot->saved_zr = slot->cr;
+        slot->saved_zi = slot->ci;
+        slot->count = 0;
+        slot->cycle = 0;
+        slot->cycle_limit = 1;
+    }
+    zi_square = slot->zi * slot->zi;
+    zr_square = slot->zr * slot->zr;
+    if (slot->count == iterations || zr_square + zi_square > 4.0)
+    {
+        out[slot->index] = slot->count;
+        slot->count = -1;
+        return ;
+    }
+    slot->zi = 2.0 * slot->zr * slot->zi;
+    slot->zr = zr_square - zi_square;
+    slot->zi += slot->ci;
+    slot->zr += slot->cr;
+    slot->count++;
+    slot->cycle++;
+    if (fabs(slot->zr - slot->saved_zr) <= tolerance && fabs(slot->zi - slot->saved_zi) <= tolerance)
+    {
+        out[slot->index] = iterations;
+        slot->count = -1;
+        return ;
+    }
+    if (slot->cycle == slot->cycle_limit)
+    {
+        slot->cycle = 0;
+        slot->cycle_limit *= 2;
+        slot->saved_zr = slot->zr;
+        slot->saved_zi = slot->zi;
+    }
+}
@@ -0,0 +1,230 @@
+#include "mandel.h"
+
+#ifdef MANDEL_X86
+
+# pragma GCC target("avx2")
+# include <immintrin.h>
+
+# define LANES 4
+
+/*
+** Offset of each lane of a refill mask in the pixels it takes, the
+** number of lanes of the mask below it
+*/
+
+static _Alignas(32) const int64_t	g_offsets[1 << LANES][LANES] = {
+	{0, 0, 0, 0}, {0, 1, 1, 1}, {0, 0, 1, 1}, {0, 1, 2, 2},
+	{0, 0, 0, 1}, {0, 1, 1, 2}, {0, 0, 1, 2}, {0, 1, 2, 3},
+	{0, 0, 0, 0}, {0, 1, 1, 1}, {0, 0, 1, 1}, {0, 1, 2, 2},
+	{0, 0, 0, 1}, {0, 1, 1, 2}, {0, 0, 1, 2}, {0, 1, 2, 3},
+};
+
+static __m256d	st_interior(__m256d cr, __m256d ci)
+{
+	__m256d	x = _mm256_sub_pd(cr, _mm256_set1_pd(0.25));
+	__m256d	y_square = _mm256_mul_pd(ci, ci);
+	__m256d	q = _mm256_add_pd(_mm256_mul_pd(x, x), y_square);
+	__m256d	cardioid = _mm256_cmp_pd(_mm256_mul_pd(q, _mm256_add_pd(q, x)),
+									 _mm256_mul_pd(_mm256_set1_pd(0.25), y_square), _CMP_LE_OQ);
+	__m256d	bulb_x = _mm256_add_pd(cr, _mm256_set1_pd(1.0));
+	__m256d	bulb = _mm256_cmp_pd(_mm256_add_pd(_mm256_mul_pd(bulb_x, bulb_x), y_square),
+								 _mm256_set1_pd(0.0625), _CMP_LE_OQ);
+
+	return _mm256_or_pd(cardioid, bulb);
+}
+
+/*
+** All ones in the lanes whose bit is set in mask
+*/
+
+static __m256i	st_lanes(int mask)
+{
+	const __m256i	bits = _mm256_set_epi64x(8, 4, 2, 1);
+
+	return _mm256_cmpeq_epi64(_mm256_and_si256(_mm256_set1_epi64x(mask), bits), bits);
+}
+
+/*
+** Lanes of the streaming kernel, iterating the pixels from next to end
+*/
+
+typedef struct
+{
+	__m256d		cr;
+	__m256d		ci;
+	__m256d		zr;
+	__m256d		zi;
+	__m256d		saved_zr;
+	__m256d		saved_zi;
+	__m256i		count;
+	__m256i		index;
+	int			active;
+	int			done;
+	int			left;
+	size_t		next;
+	size_t		end;
+}				Lanes;
+
+static Lanes		st_start(size_t next, size_t end);
+static inline void	st_advance(Lanes *lanes, const double *re, const double *im, int *out, int iterations,
+								double tolerance);
+
+/*
+** Streaming kernel: every lane iterates its own pixel and a lane that is
+** done (escaped, out of iterations or periodic) writes its count and
+** takes the next pixel of the batch, instead of idling until the slowest
+** lane of a fixed block is done. Each lane has the Brent schedule of
+** mandelbrot() from its own start, saves after 1, 3, 7... iterations
+** (count + 1 a power of two), so the counts match it exactly. Interior
+** and periodic pixels get the budget as count, an interior one is done
+** at the next check. Periodic lanes are handled off the loop-carried
+** chain, on the refill branch.
+** The batch is split between interleave (1, 2 or 4) sets of lanes
+** advanced in the same loop, their independent iterations fill the
+** latency of each other's multiply and add chain.
+*/
+
+void	mandelbrot_batch_avx2(const double *re, const double *im, int *out, size_t n, int iterations,
+							double tolerance, int interleave)
+{
+	Lanes	a;
+	Lanes	b;
+	Lanes	c;
+	Lanes	d;
+
+	if (interleave >= 4)
+	{
+		a = st_start(0, n / 4);
+		b = st_start(n / 4, n / 2);
+		c = st_start(n / 2, 3 * n / 4);
+		d = st_start(3 * n / 4, n);
+		while ((a.active | b.active | c.active | d.active | a.done | b.done | c.done | d.done) != 0)
+		{
+			st_advance(&a, re, im, out, iterations, tolerance);
+			st_advance(&b, re, im, out, iterations, tolerance);
+			st_advance(&c, re, im, out, iterations, tolerance);
+			st_advance(&d, re, im, out, iterations, tolerance);
+		}
+	}
+	else if (interleave == 2)
+	{
+		a = st_start(0, n / 2);
+		b = st_start(n / 2, n);
+		while ((a.active | b.active | a.done | b.done) != 0)
+		{
+			st_advance(&a, re, im, out, iterations, tolerance);
+			st_advance(&b, re, im, out, iterations, tolerance);
+		}
+	}
+	else
+	{
+		a = st_start(0, n);
+		while ((a.active | a.done) != 0)
+			st_advance(&a, re, im, out, iterations, tolerance);
+	}
+}
+
+static Lanes		st_start(size_t next, size_t end)
+{
+	Lanes	lanes;
+
+	lanes.cr = _mm256_setzero_pd();
+	lanes.ci = lanes.cr;
+	lanes.zr = lanes.cr;
+	lanes.zi = lanes.cr;
+	lanes.saved_zr = lanes.cr;
+	lanes.saved_zi = lanes.cr;
+	lanes.count = _mm256_setzero_si256();
+	lanes.index = lanes.count;
+	lanes.active = 0;
+	lanes.done = (1 << LANES) - 1;
+	lanes.left = 0;
+	lanes.next = next;
+	lanes.end = end;
+	return lanes;
+}
+
+/*
+** One iteration of the lanes, or their refill when some are done. Lanes
+** with nothing left to iterate have no active nor done lane.
+*/
+
+static inline void	st_advance(Lanes *lanes, const double *re, const double *im, int *out, int iterations,
+								double tolerance)
+{
+	const __m256d	abs_mask = _mm256_castsi256_pd(_mm256_set1_epi64x(INT64_MAX));
+	const __m256d	tol = _mm256_set1_pd(tolerance);
+	const __m256i	one = _mm256_set1_epi64x(1);
+	const __m256i	budget = _mm256_set1_epi64x(iterations);
+
+	if (lanes->done != 0)
+	{
+		_Alignas(32) int64_t	lane_count[LANES];
+		_Alignas(32) int64_t	lane_index[LANES];
+		int						take = 0;
+
+		_mm256_store_si256((__m256i *)lane_count, lanes->count);
+		_mm256_store_si256((__m256i *)lane_index, lanes->index);
+		for (int lane = 0; lane < LANES; lane++)
+			if (lanes->done & lanes->active & (1 << lane))
+				out[lane_index[lane]] = lane_count[lane];
+		for (int free = lanes->done; free != 0 && lanes->next + __builtin_popcount(take) < lanes->end;
+			free &= free - 1)
+			take |= free & -free;
+		__m256i	taken = st_lanes(take);
+		__m256d	taken_pd = _mm256_castsi256_pd(taken);
+
+		lanes->index = _mm256_blendv_epi8(lanes->index, _mm256_add_epi64(_mm256_set1_epi64x(lanes->next),
+			_mm256_load_si256((const __m256i *)g_offsets[take])), taken);
+		lanes->next += __builtin_popcount(take);
+		lanes->cr = _mm256_mask_i64gather_pd(lanes->cr, re, lanes->index, taken_pd, sizeof(double));
+		lanes->ci = _mm256_mask_i64gather_pd(lanes->ci, im, lanes->index, taken_pd, sizeof(double));
+		lanes->zr = _mm256_blendv_pd(lanes->zr, lanes->cr, taken_pd);
+		lanes->zi = _mm256_blendv_pd(lanes->zi, lanes->ci, taken_pd);
+		lanes->saved_zr = _mm256_blendv_pd(lanes->saved_zr, lanes->cr, taken_pd);
+		lanes->saved_zi = _mm256_blendv_pd(lanes->saved_zi, lanes->ci, taken_pd);
+		lanes->count = _mm256_andnot_si256(taken, lanes->count);
+		lanes->count = _mm256_blendv_epi8(lanes->count, budget,
+			_mm256_castpd_si256(_mm256_and_pd(taken_pd, st_interior(lanes->cr, lanes->ci))));
+		lanes->active = (lanes->active & ~lanes->done) | take;
+		lanes->done = 0;
+		_mm256_store_si256((__m256i *)lane_count, lanes->count);
+		lanes->left = iterations;
+		for (int lane = 0; lane < LANES; lane++)
+			if (lanes->active & (1 << lane))
+				lanes->left = MIN(lanes->left, iterations - (int)lane_count[lane]);
+	}
+	if (lanes->active == 0)
+		return ;
+	__m256d	zr_square = _mm256_mul_pd(lanes->zr, lanes->zr);
+	__m256d	zi_square = _mm256_mul_pd(lanes->zi, lanes->zi);
+
+	lanes->done = _mm256_movemask_pd(_mm256_cmp_pd(_mm256_add_pd(zr_square, zi_square),
+		_mm256_set1_pd(4.0), _CMP_GT_OQ)) & lanes->active;
+	if (lanes->left-- == 0)
+		lanes->done |= _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(lanes->count, budget)))
+			& lanes->active;
+	if (lanes->done != 0)
+		return ;
+	lanes->zi = _mm256_mul_pd(_mm256_add_pd(lanes->zr, lanes->zr), lanes->zi);
+	lanes->zr = _mm256_sub_pd(zr_square, zi_square);
+	lanes->zi = _mm256_add_pd(lanes->zi, lanes->ci);
+	lanes->zr = _mm256_add_pd(lanes->zr, lanes->cr);
+	lanes->count = _mm256_add_epi64(lanes->count, one);
+	int		periodic = _mm256_movemask_pd(_mm256_and_pd(
+		_mm256_cmp_pd(_mm256_and_pd(_mm256_sub_pd(lanes->zr, lanes->saved_zr), abs_mask), tol, _CMP_LE_OQ),
+		_mm256_cmp_pd(_mm256_and_pd(_mm256_sub_pd(lanes->zi, lanes->saved_zi), abs_mask), tol, _CMP_LE_OQ)))
+		& lanes->active;
+	__m256d	save = _mm256_castsi256_pd(_mm256_cmpeq_epi64(
+		_mm256_and_si256(lanes->count, _mm256_add_epi64(lanes->count, one)), _mm256_setzero_si256()));
+
+	lanes->saved_zr = _mm256_blendv_pd(lanes->saved_zr, lanes->zr, save);
+	lanes->saved_zi = _mm256_blendv_pd(lanes->saved_zi, lanes->zi, save);
+	if (periodic != 0)
+	{
+		lanes->count = _mm256_blendv_epi8(lanes->count, budget, st_lanes(periodic));
+		lanes->done = periodic;
+	}
+}
+
+#endif
@@ -0,0 +1,184 @@
+#include "mandel.h"
+
+#ifdef MANDEL_X86
+
+# pragma GCC target("avx512f")
+# include <immintrin.h>
+
+# define LANES 8
+
+static __mmask8	st_interior(__mmask8 mask, __m512d cr, __m512d ci)
+{
+	__m512d		x = _mm512_sub_pd(cr, _mm512_set1_pd(0.25));
+	__m512d		y_square = _mm512_mul_pd(ci, ci);
+	__m512d		q = _mm512_add_pd(_mm512_mul_pd(x, x), y_square);
+	__mmask8	cardioid = _mm512_mask_cmp_pd_mask(mask, _mm512_mul_pd(q, _mm512_add_pd(q, x)),
+												_mm512_mul_pd(_mm512_set1_pd(0.25), y_square), _CMP_LE_OQ);
+	__m512d		bulb_x = _mm512_add_pd(cr, _mm512_set1_pd(1.0));
+	__mmask8	bulb = _mm512_mask_cmp_pd_mask(mask, _mm512_add_pd(_mm512_mul_pd(bulb_x, bulb_x), y_square),
+											_mm512_set1_pd(0.0625), _CMP_LE_OQ);
+
+	return cardioid | bulb;
+}
+
+/*
+** Lanes of the streaming kernel, iterating the pixels from next to end
+*/
+
+typedef struct
+{
+	__m512d		cr;
+	__m512d		ci;
+	__m512d		zr;
+	__m512d		zi;
+	__m512d		saved_zr;
+	__m512d		saved_zi;
+	__m512i		count;
+	__m512i		index;
+	__mmask8	active;
+	__mmask8	done;
+	int			left;
+	size_t		next;
+	size_t		end;
+}				Lanes;
+
+static Lanes		st_start(size_t next, size_t end);
+static inline void	st_advance(Lanes *lanes, const double *re, const double *im, int *out, int iterations,
+								double tolerance);
+
+/*
+** Streaming kernel, see mandelbrot_batch_avx2(), without leaving the
+** registers: the done lanes scatter their counts to their pixel index
+** and expand-load the next pixels of the batch. Interleaved like it.
+*/
+
+void	mandelbrot_batch_avx512(const double *re, const double *im, int *out, size_t n, int iterations,
+								double tolerance, int interleave)
+{
+	Lanes	a;
+	Lanes	b;
+	Lanes	c;
+	Lanes	d;
+
+	if (interleave >= 4)
+	{
+		a = st_start(0, n / 4);
+		b = st_start(n / 4, n / 2);
+		c = st_start(n / 2, 3 * n / 4);
+		d = st_start(3 * n / 4, n);
+		while ((a.active | b.active | c.active | d.active | a.done | b.done | c.done | d.done) != 0)
+		{
+			st_advance(&a, re, im, out, iterations, tolerance);
+			st_advance(&b, re, im, out, iterations, tolerance);
+			st_advance(&c, re, im, out, iterations, tolerance);
+			st_advance(&d, re, im, out, iterations, tolerance);
+		}
+	}
+	else if (interleave == 2)
+	{
+		a = st_start(0, n / 2);
+		b = st_start(n / 2, n);
+		while ((a.active | b.active | a.done | b.done) != 0)
+		{
+			st_advance(&a, re, im, out, iterations, tolerance);
+			st_advance(&b, re, im, out, iterations, tolerance);
+		}
+	}
+	else
+	{
+		a = st_start(0, n);
+		while ((a.active | a.done) != 0)
+			st_advance(&a, re, im, out, iterations, tolerance);
+	}
+}
+
+static Lanes		st_start(size_t next, size_t end)
+{
+	Lanes	lanes;
+
+	lanes.cr = _mm512_setzero_pd();
+	lanes.ci = lanes.cr;
+	lanes.zr = lanes.cr;
+	lanes.zi = lanes.cr;
+	lanes.saved_zr = lanes.cr;
+	lanes.saved_zi = lanes.cr;
+	lanes.count = _mm512_setzero_si512();
+	lanes.index = lanes.count;
+	lanes.active = 0;
+	lanes.done = 0xff;
+	lanes.left = 0;
+	lanes.next = next;
+	lanes.end = end;
+	return lanes;
+}
+
+/*
+** One iteration of the lanes, or their refill when some are done. Lanes
+** with nothing left to iterate have no active nor done lane.
+*/
+
+static inline void	st_advance(Lanes *lanes, const double *re, const double *im, int *out, int iterations,
+								double tolerance)
+{
+	const __m512i	one = _mm512_set1_epi64(1);
+	const __m512i	budget = _mm512_set1_epi64(iterations);
+
+	if (lanes->done != 0)
+	{
+		__mmask8	take = 0;
+
+		_mm512_mask_i64scatter_epi32(out, lanes->active & lanes->done, lanes->index,
+			_mm512_cvtepi64_epi32(lanes->count), sizeof(int));
+		for (__mmask8 free = lanes->done; free != 0 && lanes->next + __builtin_popcount(take) < lanes->end;
+			free &= free - 1)
+			take |= free & -free;
+		lanes->cr = _mm512_mask_expandloadu_pd(lanes->cr, take, re + lanes->next);
+		lanes->ci = _mm512_mask_expandloadu_pd(lanes->ci, take, im + lanes->next);
+		lanes->index = _mm512_mask_expand_epi64(lanes->index, take,
+			_mm512_add_epi64(_mm512_set_epi64(7, 6, 5, 4, 3, 2, 1, 0), _mm512_set1_epi64(lanes->next)));
+		lanes->next += __builtin_popcount(take);
+		lanes->zr = _mm512_mask_mov_pd(lanes->zr, take, lanes->cr);
+		lanes->zi = _mm512_mask_mov_pd(lanes->zi, take, lanes->ci);
+		lanes->saved_zr = _mm512_mask_mov_pd(lanes->saved_zr, take, lanes->cr);
+		lanes->saved_zi = _mm512_mask_mov_pd(lanes->saved_zi, take, lanes->ci);
+		lanes->count = _mm512_mask_mov_epi64(lanes->count, take, _mm512_setzero_si512());
+		lanes->count = _mm512_mask_mov_epi64(lanes->count, st_interior(take, lanes->cr, lanes->ci), budget);
+		lanes->active = (lanes->active & ~lanes->done) | take;
+		lanes->done = 0;
+		if (lanes->active != 0)
+			lanes->left = iterations - _mm512_mask_reduce_max_epi64(lanes->active, lanes->count);
+	}
+	if (lanes->active == 0)
+		return ;
+	__m512d	zr_square = _mm512_mul_pd(lanes->zr, lanes->zr);
+	__m512d	zi_square = _mm512_mul_pd(lanes->zi, lanes->zi);
+
+	lanes->done = _mm512_mask_cmp_pd_mask(lanes->active, _mm512_add_pd(zr_square, zi_square),
+		_mm512_set1_pd(4.0), _CMP_GT_OQ);
+	if (lanes->left-- == 0)
+		lanes->done |= _mm512_mask_cmpeq_epi64_mask(lanes->active, lanes->count, budget);
+	if (lanes->done != 0)
+		return ;
+	lanes->zi = _mm512_mul_pd(_mm512_add_pd(lanes->zr, lanes->zr), lanes->zi);
+	lanes->zr = _mm512_sub_pd(zr_square, zi_square);
+	lanes->zi = _mm512_add_pd(lanes->zi, lanes->ci);
+	lanes->zr = _mm512_add_pd(lanes->zr, lanes->cr);
+	lanes->count = _mm512_add_epi64(lanes->count, one);
+
+	__mmask8	periodic = _mm512_mask_cmp_pd_mask(lanes->active,
+		_mm512_abs_pd(_mm512_sub_pd(lanes->zr, lanes->saved_zr)), _mm512_set1_pd(tolerance), _CMP_LE_OQ);
+	periodic = _mm512_mask_cmp_pd_mask(periodic,
+		_mm512_abs_pd(_mm512_sub_pd(lanes->zi, lanes->saved_zi)), _mm512_set1_pd(tolerance), _CMP_LE_OQ);
+
+	// Brent saves of mandelbrot() after 1, 3, 7... iterations of a lane
+	__mmask8	save = _mm512_testn_epi64_mask(lanes->count, _mm512_add_epi64(lanes->count, one));
+	lanes->saved_zr = _mm512_mask_mov_pd(lanes->saved_zr, save, lanes->zr);
+	lanes->saved_zi = _mm512_mask_mov_pd(lanes->saved_zi, save, lanes->zi);
+	if (periodic != 0)
+	{
+		lanes->count = _mm512_mask_mov_epi64(lanes->count, periodic, budget);
+		lanes->done = periodic;
+	}
+}
+
+#endif
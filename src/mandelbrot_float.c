@@ -0,0 +1,123 @@
+#include "mandel.h"
+
+/*
+** Float escape-time kernels for the shallow views, where the pixel is
+** wide enough for the 24 bits of a float (see precision_select): the
+** SIMD variants iterate twice as many lanes as in double.
+*/
+
+static bool	st_interior(float ca, float cb);
+static int	st_period(float ca, float cb, float zr, float zi, int cycle, float tolerance);
+
+/*
+** mandelbrot() in float, with its Brent schedule and period, the SIMD
+** variants give the same counts
+*/
+
+int			mandelbrot_float(float ca, float cb, int iterations, float tolerance, int *period)
+{
+	float	zr = ca;
+	float	zi = cb;
+	float	zr_square;
+	float	zi_square;
+	float	saved_zr = zr;
+	float	saved_zi = zi;
+	int		saved_n = 0;
+	int		n;
+
+	if (period != NULL)
+		*period = 0;
+	if (st_interior(ca, cb))
+	{
+		if (period != NULL)
+			*period = ca < -0.75f ? 2 : 1;
+		return iterations;
+	}
+	for (n = 0; n < iterations; n++)
+	{
+		zi_square = zi * zi;
+		zr_square = zr * zr;
+		if (zr_square + zi_square > 4.0f)
+			return n;
+		zi = (zr + zr) * zi;
+		zr = zr_square - zi_square;
+		zi += cb;
+		zr += ca;
+		if (fabsf(zr - saved_zr) <= tolerance && fabsf(zi - saved_zi) <= tolerance)
+		{
+			if (period != NULL)
+				*period = st_period(ca, cb, zr, zi, n + 1 - saved_n, tolerance);
+			return iterations;
+		}
+		if (((n + 1) & (n + 2)) == 0)
+		{
+			saved_zr = zr;
+			saved_zi = zi;
+			saved_n = n + 1;
+		}
+	}
+	return n;
+}
+
+/*
+** period (optional) like mandelbrot_batch()
+*/
+
+void		mandelbrot_float_batch(const float *re, const float *im, int *out, int *period, size_t n,
+								   int iterations, float tolerance)
+{
+	if (period != NULL)
+		for (size_t i = 0; i < n; i++)
+			out[i] = mandelbrot_float(re[i], im[i], iterations, tolerance, &period[i]);
+	else
+		dispatch_kernel()->batch_float(re, im, out, n, iterations, tolerance, dispatch_interleave());
+}
+
+/*
+** mandelbrot_float() pixel after pixel, the interleave is ignored
+*/
+
+void		mandelbrot_float_batch_scalar(const float *re, const float *im, int *out, size_t n, int iterations,
+										  float tolerance, int interleave)
+{
+	(void)interleave;
+	for (size_t i = 0; i < n; i++)
+		out[i] = mandelbrot_float(re[i], im[i], iterations, tolerance, NULL);
+}
+
+/*
+** The first return of z within the square root of the tolerance, like
+** st_period() in mandelbrot.c
+*/
+
+static int	st_period(float ca, float cb, float zr, float zi, int cycle, float tolerance)
+{
+	float	wr = zr;
+	float	wi = zi;
+	float	wr_square;
+	float	wi_square;
+
+	for (int k = 1; k < cycle; k++)
+	{
+		wi_square = wi * wi;
+		wr_square = wr * wr;
+		wi = (wr + wr) * wi;
+		wr = wr_square - wi_square;
+		wi += cb;
+		wr += ca;
+		if (fabsf(wr - zr) <= sqrtf(tolerance) && fabsf(wi - zi) <= sqrtf(tolerance))
+			return k;
+	}
+	return cycle;
+}
+
+static bool	st_interior(float ca, float cb)
+{
+	float	x = ca - 0.25f;
+	float	y_square = cb * cb;
+	float	q = x * x + y_square;
+
+	if (q * (q + x) <= 0.25f * y_square)
+		return true;
+	return (ca + 1.0f) * (ca + 1.0f) + y_square <= 0.0625f;
+}
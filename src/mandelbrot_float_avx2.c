@@ -0,0 +1,217 @@
+#include "mandel.h"
+
+#ifdef MANDEL_X86
+
+# pragma GCC target("avx2")
+# include <immintrin.h>
+
+# define LANES 8
+
+static __m256	st_interior(__m256 cr, __m256 ci)
+{
+	__m256	x = _mm256_sub_ps(cr, _mm256_set1_ps(0.25f));
+	__m256	y_square = _mm256_mul_ps(ci, ci);
+	__m256	q = _mm256_add_ps(_mm256_mul_ps(x, x), y_square);
+	__m256	cardioid = _mm256_cmp_ps(_mm256_mul_ps(q, _mm256_add_ps(q, x)),
+									 _mm256_mul_ps(_mm256_set1_ps(0.25f), y_square), _CMP_LE_OQ);
+	__m256	bulb_x = _mm256_add_ps(cr, _mm256_set1_ps(1.0f));
+	__m256	bulb = _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(bulb_x, bulb_x), y_square),
+								 _mm256_set1_ps(0.0625f), _CMP_LE_OQ);
+
+	return _mm256_or_ps(cardioid, bulb);
+}
+
+/*
+** All ones in the lanes whose bit is set in mask
+*/
+
+static __m256i	st_lanes(int mask)
+{
+	const __m256i	bits = _mm256_set_epi32(128, 64, 32, 16, 8, 4, 2, 1);
+
+	return _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(mask), bits), bits);
+}
+
+/*
+** Lanes of the streaming kernel, iterating the pixels from next to end
+*/
+
+typedef struct
+{
+	__m256		cr;
+	__m256		ci;
+	__m256		zr;
+	__m256		zi;
+	__m256		saved_zr;
+	__m256		saved_zi;
+	__m256i		count;
+	__m256i		index;
+	int			active;
+	int			done;
+	int			left;
+	size_t		next;
+	size_t		end;
+}				Lanes;
+
+static Lanes		st_start(size_t next, size_t end);
+static inline void	st_advance(Lanes *lanes, const float *re, const float *im, int *out, int iterations,
+								float tolerance);
+
+/*
+** mandelbrot_batch_avx2() in float, 8 lanes with 32 bit counts and
+** indices (a batch is a tile). The pixels a refill takes are written
+** lane by lane then blended in, eight gathers of a prefix table would
+** not pay for it.
+*/
+
+void	mandelbrot_float_batch_avx2(const float *re, const float *im, int *out, size_t n, int iterations,
+									float tolerance, int interleave)
+{
+	Lanes	a;
+	Lanes	b;
+	Lanes	c;
+	Lanes	d;
+
+	if (interleave >= 4)
+	{
+		a = st_start(0, n / 4);
+		b = st_start(n / 4, n / 2);
+		c = st_start(n / 2, 3 * n / 4);
+		d = st_start(3 * n / 4, n);
+		while ((a.active | b.active | c.active | d.active | a.done | b.done | c.done | d.done) != 0)
+		{
+			st_advance(&a, re, im, out, iterations, tolerance);
+			st_advance(&b, re, im, out, iterations, tolerance);
+			st_advance(&c, re, im, out, iterations, tolerance);
+			st_advance(&d, re, im, out, iterations, tolerance);
+		}
+	}
+	else if (interleave == 2)
+	{
+		a = st_start(0, n / 2);
+		b = st_start(n / 2, n);
+		while ((a.active | b.active | a.done | b.done) != 0)
+		{
+			st_advance(&a, re, im, out, iterations, tolerance);
+			st_advance(&b, re, im, out, iterations, tolerance);
+		}
+	}
+	else
+	{
+		a = st_start(0, n);
+		while ((a.active | a.done) != 0)
+			st_advance(&a, re, im, out, iterations, tolerance);
+	}
+}
+
+static Lanes		st_start(size_t next, size_t end)
+{
+	Lanes	lanes;
+
+	lanes.cr = _mm256_setzero_ps();
+	lanes.ci = lanes.cr;
+	lanes.zr = lanes.cr;
+	lanes.zi = lanes.cr;
+	lanes.saved_zr = lanes.cr;
+	lanes.saved_zi = lanes.cr;
+	lanes.count = _mm256_setzero_si256();
+	lanes.index = lanes.count;
+	lanes.active = 0;
+	lanes.done = (1 << LANES) - 1;
+	lanes.left = 0;
+	lanes.next = next;
+	lanes.end = end;
+	return lanes;
+}
+
+/*
+** One iteration of the lanes, or their refill when some are done. Lanes
+** with nothing left to iterate have no active nor done lane.
+*/
+
+static inline void	st_advance(Lanes *lanes, const float *re, const float *im, int *out, int iterations,
+								float tolerance)
+{
+	const __m256	abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(INT32_MAX));
+	const __m256	tol = _mm256_set1_ps(tolerance);
+	const __m256i	one = _mm256_set1_epi32(1);
+	const __m256i	budget = _mm256_set1_epi32(iterations);
+
+	if (lanes->done != 0)
+	{
+		_Alignas(32) int32_t	lane_count[LANES];
+		_Alignas(32) int32_t	lane_index[LANES];
+		_Alignas(32) float		lane_cr[LANES] = {0};
+		_Alignas(32) float		lane_ci[LANES] = {0};
+		int						take = 0;
+
+		_mm256_store_si256((__m256i *)lane_count, lanes->count);
+		_mm256_store_si256((__m256i *)lane_index, lanes->index);
+		for (int lane = 0; lane < LANES; lane++)
+		{
+			if (!(lanes->done & (1 << lane)))
+				continue ;
+			if (lanes->active & (1 << lane))
+				out[lane_index[lane]] = lane_count[lane];
+			if (lanes->next == lanes->end)
+				continue ;
+			lane_cr[lane] = re[lanes->next];
+			lane_ci[lane] = im[lanes->next];
+			lane_index[lane] = lanes->next++;
+			take |= 1 << lane;
+		}
+		__m256i	taken = st_lanes(take);
+		__m256	taken_ps = _mm256_castsi256_ps(taken);
+
+		lanes->index = _mm256_load_si256((const __m256i *)lane_index);
+		lanes->cr = _mm256_blendv_ps(lanes->cr, _mm256_load_ps(lane_cr), taken_ps);
+		lanes->ci = _mm256_blendv_ps(lanes->ci, _mm256_load_ps(lane_ci), taken_ps);
+		lanes->zr = _mm256_blendv_ps(lanes->zr, lanes->cr, taken_ps);
+		lanes->zi = _mm256_blendv_ps(lanes->zi, lanes->ci, taken_ps);
+		lanes->saved_zr = _mm256_blendv_ps(lanes->saved_zr, lanes->cr, taken_ps);
+		lanes->saved_zi = _mm256_blendv_ps(lanes->saved_zi, lanes->ci, taken_ps);
+		lanes->count = _mm256_andnot_si256(taken, lanes->count);
+		lanes->count = _mm256_blendv_epi8(lanes->count, budget,
+			_mm256_castps_si256(_mm256_and_ps(taken_ps, st_interior(lanes->cr, lanes->ci))));
+		lanes->active = (lanes->active & ~lanes->done) | take;
+		lanes->done = 0;
+		_mm256_store_si256((__m256i *)lane_count, lanes->count);
+		lanes->left = iterations;
+		for (int lane = 0; lane < LANES; lane++)
+			if (lanes->active & (1 << lane))
+				lanes->left = MIN(lanes->left, iterations - lane_count[lane]);
+	}
+	if (lanes->active == 0)
+		return ;
+	__m256	zr_square = _mm256_mul_ps(lanes->zr, lanes->zr);
+	__m256	zi_square = _mm256_mul_ps(lanes->zi, lanes->zi);
+
+	lanes->done = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_add_ps(zr_square, zi_square),
+		_mm256_set1_ps(4.0f), _CMP_GT_OQ)) & lanes->active;
+	if (lanes->left-- == 0)
+		lanes->done |= _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(lanes->count, budget)))
+			& lanes->active;
+	if (lanes->done != 0)
+		return ;
+	lanes->zi = _mm256_mul_ps(_mm256_add_ps(lanes->zr, lanes->zr), lanes->zi);
+	lanes->zr = _mm256_sub_ps(zr_square, zi_square);
+	lanes->zi = _mm256_add_ps(lanes->zi, lanes->ci);
+	lanes->zr = _mm256_add_ps(lanes->zr, lanes->cr);
+	lanes->count = _mm256_add_epi32(lanes->count, one);
+	int		periodic = _mm256_movemask_ps(_mm256_and_ps(
+		_mm256_cmp_ps(_mm256_and_ps(_mm256_sub_ps(lanes->zr, lanes->saved_zr), abs_mask), tol, _CMP_LE_OQ),
+		_mm256_cmp_ps(_mm256_and_ps(_mm256_sub_ps(lanes->zi, lanes->saved_zi), abs_mask), tol, _CMP_LE_OQ)))
+		& lanes->active;
+	__m256	save = _mm256_castsi256_ps(_mm256_cmpeq_epi32(
+		_mm256_and_si256(lanes->count, _mm256_add_epi32(lanes->count, one)), _mm256_setzero_si256()));
+
+	lanes->saved_zr = _mm256_blendv_ps(lanes->saved_zr, lanes->zr, save);
+	lanes->saved_zi = _mm256_blendv_ps(lanes->saved_zi, lanes->zi, save);
+	if (periodic != 0)
+	{
+		lanes->count = _mm256_blendv_epi8(lanes->count, budget, st_lanes(periodic));
+		lanes->done = periodic;
+	}
+}
+
+#endif
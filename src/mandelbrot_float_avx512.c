@@ -0,0 +1,183 @@
+#include "mandel.h"
+
+#ifdef MANDEL_X86
+
+# pragma GCC target("avx512f")
+# include <immintrin.h>
+
+# define LANES 16
+
+static __mmask16	st_interior(__mmask16 mask, __m512 cr, __m512 ci)
+{
+	__m512		x = _mm512_sub_ps(cr, _mm512_set1_ps(0.25f));
+	__m512		y_square = _mm512_mul_ps(ci, ci);
+	__m512		q = _mm512_add_ps(_mm512_mul_ps(x, x), y_square);
+	__mmask16	cardioid = _mm512_mask_cmp_ps_mask(mask, _mm512_mul_ps(q, _mm512_add_ps(q, x)),
+												_mm512_mul_ps(_mm512_set1_ps(0.25f), y_square), _CMP_LE_OQ);
+	__m512		bulb_x = _mm512_add_ps(cr, _mm512_set1_ps(1.0f));
+	__mmask16	bulb = _mm512_mask_cmp_ps_mask(mask, _mm512_add_ps(_mm512_mul_ps(bulb_x, bulb_x), y_square),
+											_mm512_set1_ps(0.0625f), _CMP_LE_OQ);
+
+	return cardioid | bulb;
+}
+
+/*
+** Lanes of the streaming kernel, iterating the pixels from next to end
+*/
+
+typedef struct
+{
+	__m512		cr;
+	__m512		ci;
+	__m512		zr;
+	__m512		zi;
+	__m512		saved_zr;
+	__m512		saved_zi;
+	__m512i		count;
+	__m512i		index;
+	__mmask16	active;
+	__mmask16	done;
+	int			left;
+	size_t		next;
+	size_t		end;
+}				Lanes;
+
+static Lanes		st_start(size_t next, size_t end);
+static inline void	st_advance(Lanes *lanes, const float *re, const float *im, int *out, int iterations,
+								float tolerance);
+
+/*
+** mandelbrot_batch_avx512() in float, 16 lanes with 32 bit counts and
+** indices (a batch is a tile)
+*/
+
+void	mandelbrot_float_batch_avx512(const float *re, const float *im, int *out, size_t n, int iterations,
+									  float tolerance, int interleave)
+{
+	Lanes	a;
+	Lanes	b;
+	Lanes	c;
+	Lanes	d;
+
+	if (interleave >= 4)
+	{
+		a = st_start(0, n / 4);
+		b = st_start(n / 4, n / 2);
+		c = st_start(n / 2, 3 * n / 4);
+		d = st_start(3 * n / 4, n);
+		while ((a.active | b.active | c.active | d.active | a.done | b.done | c.done | d.done) != 0)
+		{
+			st_advance(&a, re, im, out, iterations, tolerance);
+			st_advance(&b, re, im, out, iterations, tolerance);
+			st_advance(&c, re, im, out, iterations, tolerance);
+			st_advance(&d, re, im, out, iterations, tolerance);
+		}
+	}
+	else if (interleave == 2)
+	{
+		a = st_start(0, n / 2);
+		b = st_start(n / 2, n);
+		while ((a.active | b.active | a.done | b.done) != 0)
+		{
+			st_advance(&a, re, im, out, iterations, tolerance);
+			st_advance(&b, re, im, out, iterations, tolerance);
+		}
+	}
+	else
+	{
+		a = st_start(0, n);
+		while ((a.active | a.done) != 0)
+			st_advance(&a, re, im, out, iterations, tolerance);
+	}
+}
+
+static Lanes		st_start(size_t next, size_t end)
+{
+	Lanes	lanes;
+
+	lanes.cr = _mm512_setzero_ps();
+	lanes.ci = lanes.cr;
+	lanes.zr = lanes.cr;
+	lanes.zi = lanes.cr;
+	lanes.saved_zr = lanes.cr;
+	lanes.saved_zi = lanes.cr;
+	lanes.count = _mm512_setzero_si512();
+	lanes.index = lanes.count;
+	lanes.active = 0;
+	lanes.done = 0xffff;
+	lanes.left = 0;
+	lanes.next = next;
+	lanes.end = end;
+	return lanes;
+}
+
+/*
+** One iteration of the lanes, or their refill when some are done. Lanes
+** with nothing left to iterate have no active nor done lane.
+*/
+
+static inline void	st_advance(Lanes *lanes, const float *re, const float *im, int *out, int iterations,
+								float tolerance)
+{
+	const __m512i	one = _mm512_set1_epi32(1);
+	const __m512i	budget = _mm512_set1_epi32(iterations);
+
+	if (lanes->done != 0)
+	{
+		__mmask16	take = 0;
+
+		_mm512_mask_i32scatter_epi32(out, lanes->active & lanes->done, lanes->index, lanes->count, sizeof(int));
+		for (__mmask16 free = lanes->done; free != 0 && lanes->next + __builtin_popcount(take) < lanes->end;
+			free &= free - 1)
+			take |= free & -free;
+		lanes->cr = _mm512_mask_expandloadu_ps(lanes->cr, take, re + lanes->next);
+		lanes->ci = _mm512_mask_expandloadu_ps(lanes->ci, take, im + lanes->next);
+		lanes->index = _mm512_mask_expand_epi32(lanes->index, take,
+			_mm512_add_epi32(_mm512_set_epi32(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0),
+				_mm512_set1_epi32(lanes->next)));
+		lanes->next += __builtin_popcount(take);
+		lanes->zr = _mm512_mask_mov_ps(lanes->zr, take, lanes->cr);
+		lanes->zi = _mm512_mask_mov_ps(lanes->zi, take, lanes->ci);
+		lanes->saved_zr = _mm512_mask_mov_ps(lanes->saved_zr, take, lanes->cr);
+		lanes->saved_zi = _mm512_mask_mov_ps(lanes->saved_zi, take, lanes->ci);
+		lanes->count = _mm512_mask_mov_epi32(lanes->count, take, _mm512_setzero_si512());
+		lanes->count = _mm512_mask_mov_epi32(lanes->count, st_interior(take, lanes->cr, lanes->ci), budget);
+		lanes->active = (lanes->active & ~lanes->done) | take;
+		lanes->done = 0;
+		if (lanes->active != 0)
+			lanes->left = iterations - _mm512_mask_reduce_max_epi32(lanes->active, lanes->count);
+	}
+	if (lanes->active == 0)
+		return ;
+	__m512	zr_square = _mm512_mul_ps(lanes->zr, lanes->zr);
+	__m512	zi_square = _mm512_mul_ps(lanes->zi, lanes->zi);
+
+	lanes->done = _mm512_mask_cmp_ps_mask(lanes->active, _mm512_add_ps(zr_square, zi_square),
+		_mm512_set1_ps(4.0f), _CMP_GT_OQ);
+	if (lanes->left-- == 0)
+		lanes->done |= _mm512_mask_cmpeq_epi32_mask(lanes->active, lanes->count, budget);
+	if (lanes->done != 0)
+		return ;
+	lanes->zi = _mm512_mul_ps(_mm512_add_ps(lanes->zr, lanes->zr), lanes->zi);
+	lanes->zr = _mm512_sub_ps(zr_square, zi_square);
+	lanes->zi = _mm512_add_ps(lanes->zi, lanes->ci);
+	lanes->zr = _mm512_add_ps(lanes->zr, lanes->cr);
+	lanes->count = _mm512_add_epi32(lanes->count, one);
+
+	__mmask16	periodic = _mm512_mask_cmp_ps_mask(lanes->active,
+		_mm512_abs_ps(_mm512_sub_ps(lanes->zr, lanes->saved_zr)), _mm512_set1_ps(tolerance), _CMP_LE_OQ);
+	periodic = _mm512_mask_cmp_ps_mask(periodic,
+		_mm512_abs_ps(_mm512_sub_ps(lanes->zi, lanes->saved_zi)), _mm512_set1_ps(tolerance), _CMP_LE_OQ);
+
+	// Brent saves of mandelbrot() after 1, 3, 7... iterations of a lane
+	__mmask16	save = _mm512_testn_epi32_mask(lanes->count, _mm512_add_epi32(lanes->count, one));
+	lanes->saved_zr = _mm512_mask_mov_ps(lanes->saved_zr, save, lanes->zr);
+	lanes->saved_zi = _mm512_mask_mov_ps(lanes->saved_zi, save, lanes->zi);
+	if (periodic != 0)
+	{
+		lanes->count = _mm512_mask_mov_epi32(lanes->count, periodic, budget);
+		lanes->done = periodic;
+	}
+}
+
+#endif
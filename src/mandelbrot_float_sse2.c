@@ -0,0 +1,221 @@
+#include "mandel.h"
+
+#ifdef MANDEL_X86
+
+# pragma GCC target("sse2")
+# include <emmintrin.h>
+
+# define LANES 4
+
+static __m128	st_interior(__m128 cr, __m128 ci)
+{
+	__m128	x = _mm_sub_ps(cr, _mm_set1_ps(0.25f));
+	__m128	y_square = _mm_mul_ps(ci, ci);
+	__m128	q = _mm_add_ps(_mm_mul_ps(x, x), y_square);
+	__m128	cardioid = _mm_cmple_ps(_mm_mul_ps(q, _mm_add_ps(q, x)),
+									_mm_mul_ps(_mm_set1_ps(0.25f), y_square));
+	__m128	bulb_x = _mm_add_ps(cr, _mm_set1_ps(1.0f));
+	__m128	bulb = _mm_cmple_ps(_mm_add_ps(_mm_mul_ps(bulb_x, bulb_x), y_square),
+								_mm_set1_ps(0.0625f));
+
+	return _mm_or_ps(cardioid, bulb);
+}
+
+/*
+** All ones in the lanes whose bit is set in mask
+*/
+
+static __m128i	st_lanes(int mask)
+{
+	const __m128i	bits = _mm_set_epi32(8, 4, 2, 1);
+
+	return _mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(mask), bits), bits);
+}
+
+static __m128	st_select(__m128 mask, __m128 a, __m128 b)
+{
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+static __m128i	st_select_epi32(__m128i mask, __m128i a, __m128i b)
+{
+	return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+/*
+** Lanes of the streaming kernel, iterating the pixels from next to end
+*/
+
+typedef struct
+{
+	__m128		cr;
+	__m128		ci;
+	__m128		zr;
+	__m128		zi;
+	__m128		saved_zr;
+	__m128		saved_zi;
+	__m128i		count;
+	size_t		index[LANES];
+	int			active;
+	int			done;
+	int			left;
+	size_t		next;
+	size_t		end;
+}				Lanes;
+
+static Lanes		st_start(size_t next, size_t end);
+static inline void	st_advance(Lanes *lanes, const float *re, const float *im, int *out, int iterations,
+								float tolerance);
+
+/*
+** mandelbrot_batch_sse2() in float, 4 lanes with 32 bit counts, refilled
+** like mandelbrot_float_batch_avx2()
+*/
+
+void	mandelbrot_float_batch_sse2(const float *re, const float *im, int *out, size_t n, int iterations,
+									float tolerance, int interleave)
+{
+	Lanes	a;
+	Lanes	b;
+	Lanes	c;
+	Lanes	d;
+
+	if (interleave >= 4)
+	{
+		a = st_start(0, n / 4);
+		b = st_start(n / 4, n / 2);
+		c = st_start(n / 2, 3 * n / 4);
+		d = st_start(3 * n / 4, n);
+		while ((a.active | b.active | c.active | d.active | a.done | b.done | c.done | d.done) != 0)
+		{
+			st_advance(&a, re, im, out, iterations, tolerance);
+			st_advance(&b, re, im, out, iterations, tolerance);
+			st_advance(&c, re, im, out, iterations, tolerance);
+			st_advance(&d, re, im, out, iterations, tolerance);
+		}
+	}
+	else if (interleave == 2)
+	{
+		a = st_start(0, n / 2);
+		b = st_start(n / 2, n);
+		while ((a.active | b.active | a.done | b.done) != 0)
+		{
+			st_advance(&a, re, im, out, iterations, tolerance);
+			st_advance(&b, re, im, out, iterations, tolerance);
+		}
+	}
+	else
+	{
+		a = st_start(0, n);
+		while ((a.active | a.done) != 0)
+			st_advance(&a, re, im, out, iterations, tolerance);
+	}
+}
+
+static Lanes		st_start(size_t next, size_t end)
+{
+	Lanes	lanes;
+
+	lanes.cr = _mm_setzero_ps();
+	lanes.ci = lanes.cr;
+	lanes.zr = lanes.cr;
+	lanes.zi = lanes.cr;
+	lanes.saved_zr = lanes.cr;
+	lanes.saved_zi = lanes.cr;
+	lanes.count = _mm_setzero_si128();
+	for (int lane = 0; lane < LANES; lane++)
+		lanes.index[lane] = 0;
+	lanes.active = 0;
+	lanes.done = (1 << LANES) - 1;
+	lanes.left = 0;
+	lanes.next = next;
+	lanes.end = end;
+	return lanes;
+}
+
+/*
+** One iteration of the lanes, or their refill when some are done. Lanes
+** with nothing left to iterate have no active nor done lane.
+*/
+
+static inline void	st_advance(Lanes *lanes, const float *re, const float *im, int *out, int iterations,
+								float tolerance)
+{
+	const __m128	abs_mask = _mm_castsi128_ps(_mm_set1_epi32(INT32_MAX));
+	const __m128	tol = _mm_set1_ps(tolerance);
+	const __m128i	one = _mm_set1_epi32(1);
+	const __m128i	budget = _mm_set1_epi32(iterations);
+
+	if (lanes->done != 0)
+	{
+		_Alignas(16) int32_t	lane_count[LANES];
+		_Alignas(16) float		lane_cr[LANES] = {0};
+		_Alignas(16) float		lane_ci[LANES] = {0};
+		int						take = 0;
+
+		_mm_store_si128((__m128i *)lane_count, lanes->count);
+		for (int lane = 0; lane < LANES; lane++)
+		{
+			if (!(lanes->done & (1 << lane)))
+				continue ;
+			if (lanes->active & (1 << lane))
+				out[lanes->index[lane]] = lane_count[lane];
+			if (lanes->next == lanes->end)
+				continue ;
+			lane_cr[lane] = re[lanes->next];
+			lane_ci[lane] = im[lanes->next];
+			lanes->index[lane] = lanes->next++;
+			take |= 1 << lane;
+		}
+		__m128i	taken = st_lanes(take);
+		__m128	taken_ps = _mm_castsi128_ps(taken);
+
+		lanes->cr = st_select(taken_ps, _mm_load_ps(lane_cr), lanes->cr);
+		lanes->ci = st_select(taken_ps, _mm_load_ps(lane_ci), lanes->ci);
+		lanes->zr = st_select(taken_ps, lanes->cr, lanes->zr);
+		lanes->zi = st_select(taken_ps, lanes->ci, lanes->zi);
+		lanes->saved_zr = st_select(taken_ps, lanes->cr, lanes->saved_zr);
+		lanes->saved_zi = st_select(taken_ps, lanes->ci, lanes->saved_zi);
+		lanes->count = _mm_andnot_si128(taken, lanes->count);
+		lanes->count = _mm_or_si128(lanes->count, _mm_and_si128(budget,
+			_mm_castps_si128(_mm_and_ps(taken_ps, st_interior(lanes->cr, lanes->ci)))));
+		lanes->active = (lanes->active & ~lanes->done) | take;
+		lanes->done = 0;
+		_mm_store_si128((__m128i *)lane_count, lanes->count);
+		lanes->left = iterations;
+		for (int lane = 0; lane < LANES; lane++)
+			if (lanes->active & (1 << lane))
+				lanes->left = MIN(lanes->left, iterations - lane_count[lane]);
+	}
+	if (lanes->active == 0)
+		return ;
+	__m128	zr_square = _mm_mul_ps(lanes->zr, lanes->zr);
+	__m128	zi_square = _mm_mul_ps(lanes->zi, lanes->zi);
+
+	lanes->done = _mm_movemask_ps(_mm_cmpgt_ps(_mm_add_ps(zr_square, zi_square), _mm_set1_ps(4.0f)))
+		& lanes->active;
+	if (lanes->left-- == 0)
+		lanes->done |= _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(lanes->count, budget))) & lanes->active;
+	if (lanes->done != 0)
+		return ;
+	lanes->zi = _mm_mul_ps(_mm_add_ps(lanes->zr, lanes->zr), lanes->zi);
+	lanes->zr = _mm_sub_ps(zr_square, zi_square);
+	lanes->zi = _mm_add_ps(lanes->zi, lanes->ci);
+	lanes->zr = _mm_add_ps(lanes->zr, lanes->cr);
+	lanes->count = _mm_add_epi32(lanes->count, one);
+	int		periodic = _mm_movemask_ps(_mm_and_ps(
+		_mm_cmple_ps(_mm_and_ps(_mm_sub_ps(lanes->zr, lanes->saved_zr), abs_mask), tol),
+		_mm_cmple_ps(_mm_and_ps(_mm_sub_ps(lanes->zi, lanes->saved_zi), abs_mask), tol))) & lanes->active;
+	__m128	save = _mm_castsi128_ps(_mm_cmpeq_epi32(
+		_mm_and_si128(lanes->count, _mm_add_epi32(lanes->count, one)), _mm_setzero_si128()));
+
+	lanes->saved_zr = st_select(save, lanes->zr, lanes->saved_zr);
+	lanes->saved_zi = st_select(save, lanes->zi, lanes->saved_zi);
+	if (periodic != 0)
+	{
+		lanes->count = st_select_epi32(st_lanes(periodic), budget, lanes->count);
+		lanes->done = periodic;
+	}
+}
+
+#endif
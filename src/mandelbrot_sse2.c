@@ -0,0 +1,223 @@
+#include "mandel.h"
+
+#ifdef MANDEL_X86
+
+# pragma GCC target("sse2")
+# include <emmintrin.h>
+
+# define LANES 2
+
+static __m128d	st_interior(__m128d cr, __m128d ci)
+{
+	__m128d	x = _mm_sub_pd(cr, _mm_set1_pd(0.25));
+	__m128d	y_square = _mm_mul_pd(ci, ci);
+	__m128d	q = _mm_add_pd(_mm_mul_pd(x, x), y_square);
+	__m128d	cardioid = _mm_cmple_pd(_mm_mul_pd(q, _mm_add_pd(q, x)),
+									_mm_mul_pd(_mm_set1_pd(0.25), y_square));
+	__m128d	bulb_x = _mm_add_pd(cr, _mm_set1_pd(1.0));
+	__m128d	bulb = _mm_cmple_pd(_mm_add_pd(_mm_mul_pd(bulb_x, bulb_x), y_square),
+								_mm_set1_pd(0.0625));
+
+	return _mm_or_pd(cardioid, bulb);
+}
+
+/*
+** All ones in the lanes whose bit is set in mask
+*/
+
+static __m128i	st_lanes(int mask)
+{
+	return _mm_set_epi64x(mask & 2 ? -1 : 0, mask & 1 ? -1 : 0);
+}
+
+/*
+** Lanes of a whose 64 bit integer equals the one of b, the counts fit
+** in the low half
+*/
+
+static __m128i	st_equal(__m128i a, __m128i b)
+{
+	return _mm_shuffle_epi32(_mm_cmpeq_epi32(a, b), _MM_SHUFFLE(2, 2, 0, 0));
+}
+
+static __m128d	st_select(__m128d mask, __m128d a, __m128d b)
+{
+	return _mm_or_pd(_mm_and_pd(mask, a), _mm_andnot_pd(mask, b));
+}
+
+/*
+** Lanes of the streaming kernel, iterating the pixels from next to end
+*/
+
+typedef struct
+{
+	__m128d		cr;
+	__m128d		ci;
+	__m128d		zr;
+	__m128d		zi;
+	__m128d		saved_zr;
+	__m128d		saved_zi;
+	__m128i		count;
+	size_t		index[LANES];
+	int			active;
+	int			done;
+	int			left;
+	size_t		next;
+	size_t		end;
+}				Lanes;
+
+static Lanes		st_start(size_t next, size_t end);
+static inline void	st_advance(Lanes *lanes, const double *re, const double *im, int *out, int iterations,
+								double tolerance);
+
+/*
+** Streaming kernel, see mandelbrot_batch_avx2(), the lanes are refilled
+** one by one with half loads
+*/
+
+void	mandelbrot_batch_sse2(const double *re, const double *im, int *out, size_t n, int iterations,
+							double tolerance, int interleave)
+{
+	Lanes	a;
+	Lanes	b;
+	Lanes	c;
+	Lanes	d;
+
+	if (interleave >= 4)
+	{
+		a = st_start(0, n / 4);
+		b = st_start(n / 4, n / 2);
+		c = st_start(n / 2, 3 * n / 4);
+		d = st_start(3 * n / 4, n);
+		while ((a.active | b.active | c.active | d.active | a.done | b.done | c.done | d.done) != 0)
+		{
+			st_advance(&a, re, im, out, iterations, tolerance);
+			st_advance(&b, re, im, out, iterations, tolerance);
+			st_advance(&c, re, im, out, iterations, tolerance);
+			st_advance(&d, re, im, out, iterations, tolerance);
+		}
+	}
+	else if (interleave == 2)
+	{
+		a = st_start(0, n / 2);
+		b = st_start(n / 2, n);
+		while ((a.active | b.active | a.done | b.done) != 0)
+		{
+			st_advance(&a, re, im, out, iterations, tolerance);
+			st_advance(&b, re, im, out, iterations, tolerance);
+		}
+	}
+	else
+	{
+		a = st_start(0, n);
+		while ((a.active | a.done) != 0)
+			st_advance(&a, re, im, out, iterations, tolerance);
+	}
+}
+
+static Lanes		st_start(size_t next, size_t end)
+{
+	Lanes	lanes;
+
+	lanes.cr = _mm_setzero_pd();
+	lanes.ci = lanes.cr;
+	lanes.zr = lanes.cr;
+	lanes.zi = lanes.cr;
+	lanes.saved_zr = lanes.cr;
+	lanes.saved_zi = lanes.cr;
+	lanes.count = _mm_setzero_si128();
+	lanes.index[0] = 0;
+	lanes.index[1] = 0;
+	lanes.active = 0;
+	lanes.done = (1 << LANES) - 1;
+	lanes.left = 0;
+	lanes.next = next;
+	lanes.end = end;
+	return lanes;
+}
+
+/*
+** One iteration of the lanes, or their refill when some are done. Lanes
+** with nothing left to iterate have no active nor done lane.
+*/
+
+static inline void	st_advance(Lanes *lanes, const double *re, const double *im, int *out, int iterations,
+								double tolerance)
+{
+	const __m128d	abs_mask = _mm_castsi128_pd(_mm_set1_epi64x(INT64_MAX));
+	const __m128d	tol = _mm_set1_pd(tolerance);
+	const __m128i	one = _mm_set1_epi64x(1);
+	const __m128i	budget = _mm_set1_epi64x(iterations);
+
+	if (lanes->done != 0)
+	{
+		int64_t	lane_count[LANES];
+		int		take = 0;
+
+		_mm_storeu_si128((__m128i *)lane_count, lanes->count);
+		for (int lane = 0; lane < LANES; lane++)
+		{
+			if (!(lanes->done & (1 << lane)))
+				continue ;
+			if (lanes->active & (1 << lane))
+				out[lanes->index[lane]] = lane_count[lane];
+			if (lanes->next == lanes->end)
+				continue ;
+			lanes->cr = lane == 0 ? _mm_loadl_pd(lanes->cr, re + lanes->next)
+				: _mm_loadh_pd(lanes->cr, re + lanes->next);
+			lanes->ci = lane == 0 ? _mm_loadl_pd(lanes->ci, im + lanes->next)
+				: _mm_loadh_pd(lanes->ci, im + lanes->next);
+			lanes->index[lane] = lanes->next++;
+			take |= 1 << lane;
+		}
+		__m128i	taken = st_lanes(take);
+		__m128d	taken_pd = _mm_castsi128_pd(taken);
+
+		lanes->zr = st_select(taken_pd, lanes->cr, lanes->zr);
+		lanes->zi = st_select(taken_pd, lanes->ci, lanes->zi);
+		lanes->saved_zr = st_select(taken_pd, lanes->cr, lanes->saved_zr);
+		lanes->saved_zi = st_select(taken_pd, lanes->ci, lanes->saved_zi);
+		lanes->count = _mm_andnot_si128(taken, lanes->count);
+		lanes->count = _mm_or_si128(lanes->count, _mm_and_si128(budget,
+			_mm_castpd_si128(_mm_and_pd(taken_pd, st_interior(lanes->cr, lanes->ci)))));
+		lanes->active = (lanes->active & ~lanes->done) | take;
+		lanes->done = 0;
+		_mm_storeu_si128((__m128i *)lane_count, lanes->count);
+		lanes->left = iterations;
+		for (int lane = 0; lane < LANES; lane++)
+			if (lanes->active & (1 << lane))
+				lanes->left = MIN(lanes->left, iterations - (int)lane_count[lane]);
+	}
+	if (lanes->active == 0)
+		return ;
+	__m128d	zr_square = _mm_mul_pd(lanes->zr, lanes->zr);
+	__m128d	zi_square = _mm_mul_pd(lanes->zi, lanes->zi);
+
+	lanes->done = _mm_movemask_pd(_mm_cmpgt_pd(_mm_add_pd(zr_square, zi_square), _mm_set1_pd(4.0)))
+		& lanes->active;
+	if (lanes->left-- == 0)
+		lanes->done |= _mm_movemask_pd(_mm_castsi128_pd(st_equal(lanes->count, budget))) & lanes->active;
+	if (lanes->done != 0)
+		return ;
+	lanes->zi = _mm_mul_pd(_mm_add_pd(lanes->zr, lanes->zr), lanes->zi);
+	lanes->zr = _mm_sub_pd(zr_square, zi_square);
+	lanes->zi = _mm_add_pd(lanes->zi, lanes->ci);
+	lanes->zr = _mm_add_pd(lanes->zr, lanes->cr);
+	lanes->count = _mm_add_epi64(lanes->count, one);
+	int		periodic = _mm_movemask_pd(_mm_and_pd(
+		_mm_cmple_pd(_mm_and_pd(_mm_sub_pd(lanes->zr, lanes->saved_zr), abs_mask), tol),
+		_mm_cmple_pd(_mm_and_pd(_mm_sub_pd(lanes->zi, lanes->saved_zi), abs_mask), tol))) & lanes->active;
+	__m128d	save = _mm_castsi128_pd(st_equal(
+		_mm_and_si128(lanes->count, _mm_add_epi64(lanes->count, one)), _mm_setzero_si128()));
+
+	lanes->saved_zr = st_select(save, lanes->zr, lanes->saved_zr);
+	lanes->saved_zi = st_select(save, lanes->zi, lanes->saved_zi);
+	if (periodic != 0)
+	{
+		lanes->count = _mm_or_si128(_mm_andnot_si128(st_lanes(periodic), lanes->count),
+			_mm_and_si128(st_lanes(periodic), budget));
+		lanes->done = periodic;
+	}
+}
+
+#endif
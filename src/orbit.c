@@ -0,0 +1,183 @@
+#include "mandel.h"
+#include "config.h"
+#include <sys/mman.h>
+
+static int	st_bits(FloatExp radius);
+static int	st_precision(FloatExp radius);
+static bool	st_map(Orbit *orbit, size_t size);
+
+/*
+** Reference orbit of the center for perturbation, Z_0 = 0 and
+** Z_n+1 = Z_n^2 + C computed with Big numbers and stored as doubles,
+** or floats when compressed. It stops after the first escaped point
+** or at Z_iterations.
+** The orbit is serial so its precision is kept as low as the radius
+** allows: the limbs double when the zoom needs more than the cached
+** orbit has, otherwise the cached orbit is kept. Then it is looked up
+** in the on-disk cache, and stored there once computed.
+*/
+
+bool	orbit_compute(Orbit *orbit, const Big *center_real, const Big *center_imag,
+						FloatExp radius, int iterations, bool compressed, const OrbitCache *cache)
+{
+	int		precision = st_precision(radius);
+	size_t	part = (compressed ? sizeof(float) : sizeof(double)) * (iterations + 1);
+	Big		cr;
+	Big		ci;
+	Big		zr;
+	Big		zi;
+	Big		zr_square;
+	Big		zi_square;
+	Big		zri;
+
+	if (orbit->data != NULL && orbit->iterations == iterations
+		&& orbit->precision >= precision && orbit->compressed == compressed
+		&& big_equal(&orbit->center_real, center_real)
+		&& big_equal(&orbit->center_imag, center_imag))
+		return true;
+	if (cache->directory != NULL
+		&& orbit_cache_load(orbit, cache, center_real, center_imag, precision, iterations, compressed))
+		return true;
+	if (!st_map(orbit, 2 * part))
+		return false;
+	orbit->re = orbit->data;
+	orbit->im = (double *)((char *)orbit->data + part);
+	orbit->re_float = orbit->data;
+	orbit->im_float = (float *)((char *)orbit->data + part);
+	orbit->compressed = compressed;
+	orbit->cached = false;
+	orbit->center_real = *center_real;
+	orbit->center_imag = *center_imag;
+	orbit->iterations = iterations;
+	orbit->precision = precision;
+	orbit->length = 1;
+	if (compressed)
+	{
+		orbit->re_float[0] = 0.0f;
+		orbit->im_float[0] = 0.0f;
+	}
+	else
+	{
+		orbit->re[0] = 0.0;
+		orbit->im[0] = 0.0;
+	}
+	cr = *center_real;
+	ci = *center_imag;
+	big_set_precision(&cr, precision);
+	big_set_precision(&ci, precision);
+	big_zero(&zr);
+	big_zero(&zi);
+	big_set_precision(&zr, precision);
+	big_set_precision(&zi, precision);
+	for (int n = 1; n <= iterations; n++)
+	{
+		double	x;
+		double	y;
+
+		big_mul(&zr_square, &zr, &zr);
+		big_mul(&zi_square, &zi, &zi);
+		big_mul(&zri, &zr, &zi);
+		big_sub(&zr, &zr_square, &zi_square);
+		big_add(&zr, &zr, &cr);
+		big_mul_2(&zi, &zri);
+		big_add(&zi, &zi, &ci);
+		x = big_to_double(&zr);
+		y = big_to_double(&zi);
+		if (compressed)
+		{
+			orbit->re_float[n] = (float)x;
+			orbit->im_float[n] = (float)y;
+		}
+		else
+		{
+			orbit->re[n] = x;
+			orbit->im[n] = y;
+		}
+		orbit->length++;
+		if (x * x + y * y > 4.0)
+			break ;
+	}
+	if (cache->directory != NULL)
+		orbit_cache_store(orbit, cache);
+	return true;
+}
+
+void	orbit_free(Orbit *orbit)
+{
+	if (orbit->data != NULL)
+		munmap(orbit->data, orbit->size);
+	orbit->data = NULL;
+	orbit->size = 0;
+	orbit->length = 0;
+}
+
+/*
+** Whether a Big has the bits the orbit of radius needs, past that the
+** precision would be capped and the orbit meaningless
+*/
+
+bool	orbit_supported(FloatExp radius)
+{
+	return st_bits(radius) <= 32 * (MANDEL_BIG_LIMBS - 1);
+}
+
+static int	st_bits(FloatExp radius)
+{
+	int		bits = MANDEL_ORBIT_GUARD_BITS;
+
+	if (radius.mantissa > 0.0 && radius.exponent < 1)
+		bits += 1 - radius.exponent;
+	return bits;
+}
+
+/*
+** Limbs (the integer one included) for the bits of the radius plus
+** MANDEL_ORBIT_GUARD_BITS, rounded up to a power of two.
+*/
+
+static int	st_precision(FloatExp radius)
+{
+	int		bits = st_bits(radius);
+	int		size = 2;
+
+	while (size < MANDEL_BIG_LIMBS && 32 * (size - 1) < bits)
+		size *= 2;
+	return MIN(size, MANDEL_BIG_LIMBS);
+}
+
+/*
+** Orbits are read by every pixel of every thread, those of a huge page or
+** more get their own mapping rounded to MANDEL_HUGE_PAGE_SIZE: explicit
+** huge pages when the system has some reserved, transparent ones
+** otherwise, so a long orbit costs a few TLB entries.
+** A mapping large enough is kept.
+*/
+
+static bool	st_map(Orbit *orbit, size_t size)
+{
+	bool	huge = size >= MANDEL_HUGE_PAGE_SIZE;
+	void	*data = MAP_FAILED;
+
+	if (huge)
+		size = (size + MANDEL_HUGE_PAGE_SIZE - 1) / MANDEL_HUGE_PAGE_SIZE * MANDEL_HUGE_PAGE_SIZE;
+	if (orbit->data != NULL && orbit->size >= size)
+		return true;
+	orbit_free(orbit);
+#ifdef MAP_HUGETLB
+	if (huge)
+		data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+	if (data == MAP_FAILED)
+	{
+		data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (data == MAP_FAILED)
+			return false;
+#ifdef MADV_HUGEPAGE
+		if (huge)
+			madvise(data, size, MADV_HUGEPAGE);
+#endif
+	}
+	orbit->data = data;
+	orbit->size = size;
+	return true;
+}
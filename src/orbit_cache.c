@@ -0,0 +1,253 @@
+#include "mandel.h"
+#include "config.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define MAGIC "MANDORB3"
+#define PATH_SIZE 4096
+
+/*
+** Header of a cached orbit, followed at MANDEL_ORBIT_CACHE_ALIGN by the
+** length real parts then the length imaginary parts, doubles or floats
+*/
+
+typedef struct
+{
+	char			magic[8];
+	int				iterations;
+	int				precision;
+	int				length;
+	int				compressed;
+	Big				center_real;
+	Big				center_imag;
+}					OrbitHeader;
+
+typedef struct
+{
+	char			path[PATH_SIZE];
+	off_t			size;
+	struct timespec	time;
+}					CacheEntry;
+
+_Static_assert(sizeof(OrbitHeader) <= MANDEL_ORBIT_CACHE_ALIGN, "orbit header past its alignment");
+
+static bool		st_path(char *path, const OrbitCache *cache, const Big *center_real,
+						const Big *center_imag, int precision, int iterations, bool compressed);
+static uint64_t	st_hash(uint64_t hash, const void *data, size_t size);
+static uint64_t	st_hash_big(uint64_t hash, const Big *big);
+static void		st_evict(const OrbitCache *cache);
+static int		st_compare_time(const void *a, const void *b);
+
+/*
+** Map the orbit of this center, precision, iteration count and storage
+** from the cache directory, copy on write so the mapping is reused like
+** a computed one. A hit touches the file, eviction drops the least
+** recently used. The header is checked in full, a hash collision or a
+** file from another build is a miss.
+*/
+
+bool	orbit_cache_load(Orbit *orbit, const OrbitCache *cache, const Big *center_real,
+						const Big *center_imag, int precision, int iterations, bool compressed)
+{
+	char			path[PATH_SIZE];
+	struct stat		info;
+	OrbitHeader		*header;
+	void			*data;
+	size_t			part;
+	int				fd;
+
+	if (!st_path(path, cache, center_real, center_imag, precision, iterations, compressed)
+		|| (fd = open(path, O_RDONLY)) < 0)
+		return false;
+	data = MAP_FAILED;
+	if (fstat(fd, &info) == 0 && info.st_size >= MANDEL_ORBIT_CACHE_ALIGN)
+		data = mmap(NULL, info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	if (data != MAP_FAILED)
+		futimens(fd, NULL);
+	close(fd);
+	if (data == MAP_FAILED)
+		return false;
+	header = data;
+	part = (compressed ? sizeof(float) : sizeof(double)) * header->length;
+	if (memcmp(header->magic, MAGIC, sizeof(header->magic)) != 0
+		|| header->iterations != iterations || header->precision != precision
+		|| header->compressed != compressed || header->length < 1 || header->length > iterations + 1
+		|| (size_t)info.st_size != MANDEL_ORBIT_CACHE_ALIGN + 2 * part
+		|| !big_equal(&header->center_real, center_real)
+		|| !big_equal(&header->center_imag, center_imag))
+	{
+		munmap(data, info.st_size);
+		return false;
+	}
+	orbit_free(orbit);
+	orbit->data = data;
+	orbit->size = info.st_size;
+	orbit->re = (double *)((char *)data + MANDEL_ORBIT_CACHE_ALIGN);
+	orbit->im = (double *)((char *)data + MANDEL_ORBIT_CACHE_ALIGN + part);
+	orbit->re_float = (float *)orbit->re;
+	orbit->im_float = (float *)orbit->im;
+	orbit->compressed = compressed;
+	orbit->length = header->length;
+	orbit->iterations = iterations;
+	orbit->precision = precision;
+	orbit->center_real = *center_real;
+	orbit->center_imag = *center_imag;
+	orbit->cached = true;
+	return true;
+}
+
+/*
+** Written under a temporary name then renamed, so a concurrent render
+** never maps half a file. The temporary name is unique to the call, the
+** workers of the pool store the grid references at the same time, and
+** eviction only looks at renamed files. Orbits larger than the limit are
+** not cached.
+*/
+
+void	orbit_cache_store(const Orbit *orbit, const OrbitCache *cache)
+{
+	char			path[PATH_SIZE];
+	char			temporary[PATH_SIZE + 8];
+	static char		padding[MANDEL_ORBIT_CACHE_ALIGN];
+	OrbitHeader		header;
+	size_t			part = (orbit->compressed ? sizeof(float) : sizeof(double)) * orbit->length;
+	FILE			*file;
+	int				fd;
+	bool			ok;
+
+	if (MANDEL_ORBIT_CACHE_ALIGN + 2 * part > cache->limit
+		|| !st_path(path, cache, &orbit->center_real, &orbit->center_imag,
+			orbit->precision, orbit->iterations, orbit->compressed))
+		return ;
+	mkdir(cache->directory, 0755);
+	snprintf(temporary, sizeof(temporary), "%s.XXXXXX", path);
+	if ((fd = mkstemp(temporary)) < 0)
+		return ;
+	if (fchmod(fd, 0644) != 0 || (file = fdopen(fd, "wb")) == NULL)
+	{
+		close(fd);
+		remove(temporary);
+		return ;
+	}
+	memset(&header, 0, sizeof(OrbitHeader));
+	memcpy(header.magic, MAGIC, sizeof(header.magic));
+	header.iterations = orbit->iterations;
+	header.precision = orbit->precision;
+	header.length = orbit->length;
+	header.compressed = orbit->compressed;
+	header.center_real = orbit->center_real;
+	header.center_imag = orbit->center_imag;
+	ok = fwrite(&header, sizeof(OrbitHeader), 1, file) == 1
+		&& fwrite(padding, MANDEL_ORBIT_CACHE_ALIGN - sizeof(OrbitHeader), 1, file) == 1
+		&& fwrite(orbit->compressed ? (void *)orbit->re_float : (void *)orbit->re, part, 1, file) == 1
+		&& fwrite(orbit->compressed ? (void *)orbit->im_float : (void *)orbit->im, part, 1, file) == 1;
+	ok = fclose(file) == 0 && ok;
+	if (!ok || rename(temporary, path) != 0)
+	{
+		remove(temporary);
+		return ;
+	}
+	st_evict(cache);
+}
+
+static bool		st_path(char *path, const OrbitCache *cache, const Big *center_real,
+						const Big *center_imag, int precision, int iterations, bool compressed)
+{
+	uint64_t	hash = 0xcbf29ce484222325;
+	int			length;
+
+	hash = st_hash_big(hash, center_real);
+	hash = st_hash_big(hash, center_imag);
+	hash = st_hash(hash, &precision, sizeof(int));
+	hash = st_hash(hash, &iterations, sizeof(int));
+	hash = st_hash(hash, &compressed, sizeof(bool));
+	length = snprintf(path, PATH_SIZE, "%s/%016llx.orbit", cache->directory, (unsigned long long)hash);
+	return length > 0 && length < PATH_SIZE;
+}
+
+/*
+** FNV-1a
+*/
+
+static uint64_t	st_hash(uint64_t hash, const void *data, size_t size)
+{
+	const unsigned char	*bytes = data;
+
+	for (size_t i = 0; i < size; i++)
+		hash = (hash ^ bytes[i]) * 0x100000001b3;
+	return hash;
+}
+
+/*
+** Only the limbs in use, and the sign of a zero is ignored like big_equal
+*/
+
+static uint64_t	st_hash_big(uint64_t hash, const Big *big)
+{
+	bool	negative = big->negative && !big_is_zero(big);
+
+	hash = st_hash(hash, &negative, sizeof(bool));
+	hash = st_hash(hash, &big->size, sizeof(int));
+	return st_hash(hash, &big->limbs[MANDEL_BIG_LIMBS - big->size], sizeof(uint32_t) * big->size);
+}
+
+/*
+** Remove the least recently used orbits until the directory fits the limit
+*/
+
+static void		st_evict(const OrbitCache *cache)
+{
+	DIR				*dir;
+	struct dirent	*entry;
+	struct stat		info;
+	CacheEntry		*entries = NULL;
+	CacheEntry		*grown;
+	size_t			count = 0;
+	size_t			capacity = 0;
+	off_t			total = 0;
+	size_t			suffix = strlen(".orbit");
+
+	if ((dir = opendir(cache->directory)) == NULL)
+		return ;
+	while ((entry = readdir(dir)) != NULL)
+	{
+		size_t	length = strlen(entry->d_name);
+
+		if (length <= suffix || strcmp(entry->d_name + length - suffix, ".orbit") != 0)
+			continue ;
+		if (count == capacity)
+		{
+			capacity = capacity == 0 ? 16 : capacity * 2;
+			if ((grown = realloc(entries, sizeof(CacheEntry) * capacity)) == NULL)
+				break ;
+			entries = grown;
+		}
+		snprintf(entries[count].path, PATH_SIZE, "%s/%s", cache->directory, entry->d_name);
+		if (stat(entries[count].path, &info) != 0)
+			continue ;
+		entries[count].size = info.st_size;
+		entries[count].time = info.st_mtim;
+		total += info.st_size;
+		count++;
+	}
+	closedir(dir);
+	if (count > 0)
+		qsort(entries, count, sizeof(CacheEntry), st_compare_time);
+	for (size_t i = 0; i < count && (size_t)total > cache->limit; i++)
+		if (remove(entries[i].path) == 0)
+			total -= entries[i].size;
+	free(entries);
+}
+
+static int		st_compare_time(const void *a, const void *b)
+{
+	struct timespec	time_a = ((const CacheEntry *)a)->time;
+	struct timespec	time_b = ((const CacheEntry *)b)->time;
+
+	if (time_a.tv_sec != time_b.tv_sec)
+		return (time_a.tv_sec > time_b.tv_sec) - (time_a.tv_sec < time_b.tv_sec);
+	return (time_a.tv_nsec > time_b.tv_nsec) - (time_a.tv_nsec < time_b.tv_nsec);
+}
@@ -0,0 +1,221 @@
+#include "mandel.h"
+#include "config.h"
+
+static bool	st_floatexp(const Reference *reference, double dcr, double dci, int iterations,
+						int *n, double *dzr, double *dzi);
+
+/*
+** Reference orbit of the center moved by offset (scaled like the radii),
+** then the series and the BLA table which depend on the size of the view
+** seen from there, the deltas spanning the radii plus the offset.
+** The series coefficients are scaled by powers of the radius which do not
+** hold past the range of a double, it is left out there.
+** With orbit_float and without rebasing the orbit is compressed to
+** floats, half the memory and bandwidth at any zoom: Z only scales the
+** delta there (2 Z dz), so its rounding stays relative to the delta. A
+** rebased delta takes z = Z + dz as is, the float rounding of Z would
+** land far above a pixel, so rebased orbits are kept in doubles.
+*/
+
+bool	perturbation_prepare(Reference *reference, const State *state, Point offset)
+{
+	double	radius_real = state->radius_real + fabs(offset.x);
+	double	radius_imag = state->radius_imag + fabs(offset.y);
+	Big		center_real = state->center_real;
+	Big		center_imag = state->center_imag;
+	Big		shift;
+
+	reference->offset = offset;
+	reference->exponent = state->radius_exponent;
+	reference->rebase = state->rebase;
+	big_from_floatexp(&shift, fe_make(offset.x, state->radius_exponent));
+	big_add(&center_real, &center_real, &shift);
+	big_from_floatexp(&shift, fe_make(offset.y, state->radius_exponent));
+	big_add(&center_imag, &center_imag, &shift);
+	if (!orbit_compute(&reference->orbit, &center_real, &center_imag,
+			fe_make(MIN(state->radius_real, state->radius_imag), state->radius_exponent),
+			state->iterations, state->orbit_float && !state->rebase,
+			&state->orbit_cache))
+		return false;
+	if (reference->exponent == 0)
+		series_compute(&reference->series, &reference->orbit,
+				radius_real, radius_imag, state->iterations);
+	else
+		memset(&reference->series, 0, sizeof(Series));
+	return bla_compute(&reference->bla, &reference->orbit,
+			ldexp(hypot(radius_real, radius_imag), state->radius_exponent));
+}
+
+void	perturbation_free(Reference *reference)
+{
+	orbit_free(&reference->orbit);
+	bla_free(&reference->bla);
+}
+
+/*
+** Escape count of C + dc iterating only the delta against the reference:
+** dz_m+1 = 2 Z_m dz_m + dz_m^2 + dc, with z = Z_m + dz_m.
+** The count matches mandelbrot() which starts at z = c (Z_1 here).
+** With rebasing (Zhuoran), when z comes closer to 0 than the delta or
+** the reference ends, the delta restarts from Z_0 = 0 as dz = z, so m
+** (the reference index) runs apart from n (the count) and a short
+** reference serves every pixel without glitches.
+** Without rebasing, past the end of an escaped reference the point
+** carries on in plain double, which is only exact close to the reference.
+** The delta starts at the iteration skipped by the series, unless the
+** point already escaped there, then jumps ahead with the longest valid
+** BLA step. A jump landing outside the escape radius is not taken so
+** the count stays exact.
+** Without rebasing, *glitched is set when z comes much closer to 0 than
+** the reference (Pauldelbrot: |Z + dz| < MANDEL_GLITCH_TOLERANCE |Z|),
+** the delta has lost its precision and the count may be wrong.
+** The offset is scaled by 2^-exponent: past the range of a double the
+** delta is first iterated as FloatExp, until it is large enough for
+** the double iterations where the offset may underflow to nothing.
+*/
+
+int		perturbation(const Reference *reference, double dcr, double dci, int iterations, bool *glitched)
+{
+	const Orbit		*orbit = &reference->orbit;
+	const Series	*series = &reference->series;
+	double			dzr = 0.0;
+	double			dzi = 0.0;
+	double			zr;
+	double			zi;
+	int				n = 0;
+	int				m;
+
+	*glitched = false;
+	if (reference->exponent != 0)
+	{
+		if (st_floatexp(reference, dcr, dci, iterations, &n, &dzr, &dzi))
+			return n;
+		dcr = ldexp(dcr, reference->exponent);
+		dci = ldexp(dci, reference->exponent);
+	}
+	else if (series->skip > 0)
+	{
+		series_evaluate(series, dcr / series->scale, dci / series->scale, &dzr, &dzi);
+		zr = ORBIT_RE(orbit, series->skip) + dzr;
+		zi = ORBIT_IM(orbit, series->skip) + dzi;
+		if (zr * zr + zi * zi <= 4.0)
+			n = series->skip;
+		else
+		{
+			dzr = 0.0;
+			dzi = 0.0;
+		}
+	}
+	m = n;
+	zr = ORBIT_RE(orbit, m) + dzr;
+	zi = ORBIT_IM(orbit, m) + dzi;
+	for (; n < iterations; n++, m++)
+	{
+		const Bla	*step;
+		double		ref_re;
+		double		ref_im;
+		double		t;
+
+		if (m + 1 >= orbit->length || (reference->rebase && zr * zr + zi * zi < dzr * dzr + dzi * dzi))
+		{
+			if (!reference->rebase)
+				break ;
+			dzr = zr;
+			dzi = zi;
+			m = 0;
+		}
+		if ((step = bla_lookup(&reference->bla, m, dzr * dzr + dzi * dzi, iterations - n)) != NULL)
+		{
+			double	jump_re = step->a_re * dzr - step->a_im * dzi + step->b_re * dcr - step->b_im * dci;
+			double	jump_im = step->a_re * dzi + step->a_im * dzr + step->b_re * dci + step->b_im * dcr;
+			double	jump_zr = ORBIT_RE(orbit, m + step->length) + jump_re;
+			double	jump_zi = ORBIT_IM(orbit, m + step->length) + jump_im;
+
+			if (jump_zr * jump_zr + jump_zi * jump_zi <= 4.0)
+			{
+				dzr = jump_re;
+				dzi = jump_im;
+				zr = jump_zr;
+				zi = jump_zi;
+				n += step->length - 1;
+				m += step->length - 1;
+				continue ;
+			}
+		}
+		ref_re = ORBIT_RE(orbit, m);
+		ref_im = ORBIT_IM(orbit, m);
+		t = 2.0 * (ref_re * dzi + ref_im * dzr) + 2.0 * dzr * dzi + dci;
+
+		dzr = 2.0 * (ref_re * dzr - ref_im * dzi) + dzr * dzr - dzi * dzi + dcr;
+		dzi = t;
+		ref_re = ORBIT_RE(orbit, m + 1);
+		ref_im = ORBIT_IM(orbit, m + 1);
+		zr = ref_re + dzr;
+		zi = ref_im + dzi;
+		if (zr * zr + zi * zi > 4.0)
+			return n;
+		if (!reference->rebase && zr * zr + zi * zi < MANDEL_GLITCH_TOLERANCE * MANDEL_GLITCH_TOLERANCE
+			* (ref_re * ref_re + ref_im * ref_im))
+			*glitched = true;
+	}
+	if (n == iterations)
+		return n;
+	dcr += big_to_double(&orbit->center_real);
+	dci += big_to_double(&orbit->center_imag);
+	for (; n < iterations; n++)
+	{
+		double	zr_square = zr * zr;
+		double	zi_square = zi * zi;
+
+		zi = 2.0 * zr * zi + dci;
+		zr = zr_square - zi_square + dcr;
+		if (zr * zr + zi * zi > 4.0)
+			return n;
+	}
+	return n;
+}
+
+void	perturbation_batch(const Reference *reference, const double *dcr, const double *dci,
+							int *out, bool *glitched, size_t n, int iterations)
+{
+	for (size_t i = 0; i < n; i++)
+		out[i] = perturbation(reference, dcr[i], dci[i], iterations, &glitched[i]);
+}
+
+/*
+** Delta iterations in FloatExp while it is under 2^MANDEL_FLOATEXP_EXPONENT,
+** true when the point escaped and *n is its count.
+*/
+
+static bool	st_floatexp(const Reference *reference, double dcr, double dci, int iterations,
+						int *n, double *dzr, double *dzi)
+{
+	const Orbit	*orbit = &reference->orbit;
+	FloatExp	fe_dcr = fe_make(dcr, reference->exponent);
+	FloatExp	fe_dci = fe_make(dci, reference->exponent);
+	FloatExp	fe_dzr = fe_make(0.0, 0);
+	FloatExp	fe_dzi = fe_make(0.0, 0);
+	double		zr;
+	double		zi;
+
+	for (*n = 0; *n < iterations && *n + 1 < orbit->length; (*n)++)
+	{
+		FloatExp	t;
+
+		if ((fe_dzr.mantissa != 0.0 && fe_dzr.exponent > MANDEL_FLOATEXP_EXPONENT)
+			|| (fe_dzi.mantissa != 0.0 && fe_dzi.exponent > MANDEL_FLOATEXP_EXPONENT))
+			break ;
+		t = fe_add(fe_add(fe_add(fe_mul_double(fe_dzi, 2.0 * ORBIT_RE(orbit, *n)), fe_mul_double(fe_dzr, 2.0 * ORBIT_IM(orbit, *n))),
+				fe_mul_double(fe_mul(fe_dzr, fe_dzi), 2.0)), fe_dci);
+		fe_dzr = fe_add(fe_add(fe_sub(fe_mul_double(fe_dzr, 2.0 * ORBIT_RE(orbit, *n)), fe_mul_double(fe_dzi, 2.0 * ORBIT_IM(orbit, *n))),
+				fe_sub(fe_mul(fe_dzr, fe_dzr), fe_mul(fe_dzi, fe_dzi))), fe_dcr);
+		fe_dzi = t;
+		zr = ORBIT_RE(orbit, *n + 1) + fe_to_double(fe_dzr);
+		zi = ORBIT_IM(orbit, *n + 1) + fe_to_double(fe_dzi);
+		if (zr * zr + zi * zi > 4.0)
+			return true;
+	}
+	*dzr = fe_to_double(fe_dzr);
+	*dzi = fe_to_double(fe_dzi);
+	return false;
+}
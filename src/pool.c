@@ -0,0 +1,184 @@
+#include "mandel.h"
+
+#include <unistd.h>
+
+static void	*st_worker(void *data);
+static bool	st_next(Worker *worker, int *task);
+static bool	st_pop(Worker *worker, int *task);
+static bool	st_steal(Worker *victim, int *task);
+
+bool		pool_init(Pool *pool, int size)
+{
+	if (size <= 0)
+		size = sysconf(_SC_NPROCESSORS_ONLN);
+	if (size <= 0)
+		size = 1;
+	pool->size = 0;
+	pool->generation = 0;
+	pool->finished = 0;
+	pool->quit = false;
+	if ((pool->workers = calloc(size, sizeof(Worker))) == NULL)
+		return false;
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->start, NULL);
+	pthread_cond_init(&pool->done, NULL);
+	for (int i = 0; i < size; i++)
+	{
+		Worker	*worker = &pool->workers[i];
+
+		pthread_mutex_init(&worker->lock, NULL);
+		worker->pool = pool;
+		worker->self = i;
+		worker->seed = i * 2654435761u + 1;
+		if (pthread_create(&worker->thread, NULL, st_worker, worker) != 0)
+		{
+			pthread_mutex_destroy(&worker->lock);
+			pool_quit(pool);
+			return false;
+		}
+		pool->size++;
+	}
+	return true;
+}
+
+void		pool_quit(Pool *pool)
+{
+	pthread_mutex_lock(&pool->lock);
+	pool->quit = true;
+	pthread_cond_broadcast(&pool->start);
+	pthread_mutex_unlock(&pool->lock);
+	for (int i = 0; i < pool->size; i++)
+	{
+		pthread_join(pool->workers[i].thread, NULL);
+		pthread_mutex_destroy(&pool->workers[i].lock);
+		free(pool->workers[i].tasks);
+	}
+	pthread_mutex_destroy(&pool->lock);
+	pthread_cond_destroy(&pool->start);
+	pthread_cond_destroy(&pool->done);
+	free(pool->workers);
+	pool->workers = NULL;
+	pool->size = 0;
+}
+
+/*
+** Deal tasks [0, count) in contiguous runs to the worker deques,
+** wake the workers and wait until every task was executed.
+** A worker runs its own tasks in order and, once its deque is empty,
+** steals from the far end of a random victim's deque. func also gets the
+** index of the worker running the task, in [0, size), to pick its own
+** scratch buffers.
+*/
+
+bool		pool_run(Pool *pool, int count, void (*func)(void *arg, int worker, int task), void *arg)
+{
+	for (int i = 0; i < pool->size; i++)
+	{
+		Worker	*worker = &pool->workers[i];
+		int		start = (long)count * i / pool->size;
+		int		end = (long)count * (i + 1) / pool->size;
+
+		if (end - start > worker->capacity)
+		{
+			free(worker->tasks);
+			if ((worker->tasks = malloc(sizeof(int) * (end - start))) == NULL)
+			{
+				worker->capacity = 0;
+				return false;
+			}
+			worker->capacity = end - start;
+		}
+		// the owner pops from the top (next in order), thieves take the bottom
+		for (int j = 0; j < end - start; j++)
+			worker->tasks[j] = end - 1 - j;
+		worker->bottom = 0;
+		worker->top = end - start;
+	}
+	pthread_mutex_lock(&pool->lock);
+	pool->func = func;
+	pool->arg = arg;
+	pool->finished = 0;
+	pool->generation++;
+	pthread_cond_broadcast(&pool->start);
+	while (pool->finished < pool->size)
+		pthread_cond_wait(&pool->done, &pool->lock);
+	pthread_mutex_unlock(&pool->lock);
+	return true;
+}
+
+static void	*st_worker(void *data)
+{
+	Worker			*worker = data;
+	Pool			*pool = worker->pool;
+	unsigned long	generation = 0;
+	int				task;
+
+	while (true)
+	{
+		pthread_mutex_lock(&pool->lock);
+		while (!pool->quit && pool->generation == generation)
+			pthread_cond_wait(&pool->start, &pool->lock);
+		if (pool->quit)
+		{
+			pthread_mutex_unlock(&pool->lock);
+			return NULL;
+		}
+		generation = pool->generation;
+		pthread_mutex_unlock(&pool->lock);
+
+		while (st_next(worker, &task))
+			pool->func(pool->arg, worker->self, task);
+
+		pthread_mutex_lock(&pool->lock);
+		pool->finished++;
+		pthread_cond_signal(&pool->done);
+		pthread_mutex_unlock(&pool->lock);
+	}
+}
+
+/*
+** Tasks are never added while a run is in progress,
+** so once every deque was seen empty there is nothing left to steal.
+*/
+
+static bool	st_next(Worker *worker, int *task)
+{
+	Pool	*pool = worker->pool;
+	int		victim;
+
+	if (st_pop(worker, task))
+		return true;
+	worker->seed ^= worker->seed << 13;
+	worker->seed ^= worker->seed >> 17;
+	worker->seed ^= worker->seed << 5;
+	victim = worker->seed % pool->size;
+	for (int i = 0; i < pool->size; i++)
+	{
+		if (victim != worker->self && st_steal(&pool->workers[victim], task))
+			return true;
+		victim = (victim + 1) % pool->size;
+	}
+	return false;
+}
+
+static bool	st_pop(Worker *worker, int *task)
+{
+	bool	found;
+
+	pthread_mutex_lock(&worker->lock);
+	if ((found = worker->top > worker->bottom))
+		*task = worker->tasks[--worker->top];
+	pthread_mutex_unlock(&worker->lock);
+	return found;
+}
+
+static bool	st_steal(Worker *victim, int *task)
+{
+	bool	found;
+
+	pthread_mutex_lock(&victim->lock);
+	if ((found = victim->top > victim->bottom))
+		*task = victim->tasks[victim->bottom++];
+	pthread_mutex_unlock(&victim->lock);
+	return found;
+}
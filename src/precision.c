@@ -0,0 +1,46 @@
+#include "mandel.h"
+#include "config.h"
+#include <float.h>
+
+#define DOUBLE_DOUBLE_EPSILON 0x1p-104
+
+/*
+** Precision ladder: the cheapest number type whose rounding of z
+** (|z| < 2, so 2 epsilon) stays under 1 / margin of a pixel. Every
+** iteration adds its own rounding so the margin is
+** MANDEL_PRECISION_MARGIN times the iterations, log2(iterations) bits
+** more for deeper budgets. Float (the shader), double, double-double
+** then perturbation, whose deltas go FloatExp on their own past the
+** range of a double. The pixel comes from the radii rather than the
+** double bounds which collapse at the zooms this is about.
+*/
+
+int			precision_select(const State *state)
+{
+	double	pixel = ldexp(MIN(2.0 * state->radius_real / state->width,
+							2.0 * state->radius_imag / state->height), state->radius_exponent);
+	double	margin = MANDEL_PRECISION_MARGIN * MAX(state->iterations, 1);
+
+	if (pixel >= margin * 2.0 * FLT_EPSILON)
+		return PRECISION_FLOAT;
+	if (pixel >= margin * 2.0 * DBL_EPSILON)
+		return PRECISION_DOUBLE;
+	if (pixel >= margin * 2.0 * DOUBLE_DOUBLE_EPSILON)
+		return PRECISION_DOUBLE_DOUBLE;
+	return PRECISION_PERTURBATION;
+}
+
+const char	*precision_name(int precision)
+{
+	static const char	*names[] = {
+		[PRECISION_DOUBLE] = "double",
+		[PRECISION_DOUBLE_DOUBLE] = "double-double",
+		[PRECISION_PERTURBATION] = "perturbation",
+		[PRECISION_FLOAT] = "float",
+		[PRECISION_FIXED64] = "fixed64",
+		[PRECISION_FIXED128] = "fixed128",
+		[PRECISION_AUTO] = "auto",
+	};
+
+	return names[precision];
+}
@@ -0,0 +1,143 @@
+#include "mandel.h"
+#include "config.h"
+
+/*
+** A cell of the reference grid, with the pixels it covers
+*/
+
+typedef struct
+{
+	State		*state;
+	int			x_start;
+	int			y_start;
+	int			x_end;
+	int			y_end;
+	bool		ok;
+}				Cell;
+
+static void	st_prepare_cell(void *arg, int worker, int task);
+static Point	st_pixel(const State *state, int x, int y);
+
+/*
+** References of a perturbation render: the center's first, then with a
+** grid of reference_grid * reference_grid cells (more than one) one per
+** cell, at the deepest of MANDEL_REFERENCE_PROBES^2 pixels probed in it
+** against the center's. A wide frame spanning several minibrots gets a
+** reference in each that does not escape early, and the tiles iterate
+** against the nearest one so their deltas stay small.
+** The cells are prepared in parallel, each writes only its reference.
+*/
+
+bool	references_prepare(State *state)
+{
+	int		grid = state->reference_grid > 1 ? MIN(state->reference_grid, MANDEL_REFERENCE_GRID_MAX) : 1;
+	int		count = grid > 1 ? grid * grid + 1 : 1;
+	Cell	cells[MANDEL_REFERENCES_MAX];
+	bool	ok;
+
+	for (int i = count; i < state->references_count; i++)
+		perturbation_free(&state->references[i]);
+	state->references_count = count;
+	if (!perturbation_prepare(&state->references[0], state, (Point){0.0, 0.0}))
+		return false;
+	for (int i = 1; i < count; i++)
+	{
+		cells[i].state = state;
+		cells[i].x_start = (i - 1) % grid * state->width / grid;
+		cells[i].x_end = ((i - 1) % grid + 1) * state->width / grid;
+		cells[i].y_start = (i - 1) / grid * state->height / grid;
+		cells[i].y_end = ((i - 1) / grid + 1) * state->height / grid;
+		cells[i].ok = false;
+	}
+	ok = count == 1 || pool_run(&state->pool, count - 1, st_prepare_cell, cells + 1);
+	for (int i = 1; ok && i < count; i++)
+		ok = cells[i].ok;
+	return ok;
+}
+
+/*
+** Reference whose center is closest to offset (scaled like the radii)
+*/
+
+const Reference	*references_nearest(const State *state, Point offset)
+{
+	const Reference	*nearest = &state->references[0];
+	double			best = INFINITY;
+
+	for (int i = 0; i < state->references_count; i++)
+	{
+		double	dx = state->references[i].offset.x - offset.x;
+		double	dy = state->references[i].offset.y - offset.y;
+
+		if (dx * dx + dy * dy < best)
+		{
+			nearest = &state->references[i];
+			best = dx * dx + dy * dy;
+		}
+	}
+	return nearest;
+}
+
+void	references_free(State *state)
+{
+	for (int i = 0; i < state->references_count; i++)
+		perturbation_free(&state->references[i]);
+	state->references_count = 0;
+}
+
+/*
+** Probes are pixel centers so the reference pixel gets a zero delta,
+** ties go to the probe closest to the middle of the cell. They always
+** rebase so their counts hold without glitch correction.
+*/
+
+static void	st_prepare_cell(void *arg, int worker, int task)
+{
+	Cell		*cell = (Cell *)arg + task;
+	State		*state = cell->state;
+	Reference	*reference = &state->references[task + 1];
+	Reference	probe = state->references[0];
+	int			width = cell->x_end - cell->x_start;
+	int			height = cell->y_end - cell->y_start;
+	int			best_count = -1;
+	double		best_distance = INFINITY;
+	Point		best = {0.0, 0.0};
+
+	(void)worker;
+	probe.rebase = true;
+	for (int j = 0; j < MANDEL_REFERENCE_PROBES; j++)
+	{
+		for (int i = 0; i < MANDEL_REFERENCE_PROBES; i++)
+		{
+			int		x = cell->x_start + (2 * i + 1) * width / (2 * MANDEL_REFERENCE_PROBES);
+			int		y = cell->y_start + (2 * j + 1) * height / (2 * MANDEL_REFERENCE_PROBES);
+			Point	offset = st_pixel(state, x, y);
+			double	dx = x - (cell->x_start + cell->x_end) / 2.0;
+			double	dy = y - (cell->y_start + cell->y_end) / 2.0;
+			bool	glitched;
+			int		count;
+
+			count = perturbation(&probe, offset.x, offset.y, state->iterations, &glitched);
+			if (count > best_count || (count == best_count && dx * dx + dy * dy < best_distance))
+			{
+				best_count = count;
+				best_distance = dx * dx + dy * dy;
+				best = offset;
+			}
+		}
+	}
+	cell->ok = perturbation_prepare(reference, state, best);
+}
+
+/*
+** Offset of a pixel center from the center of the view, like render_cpu
+*/
+
+static Point	st_pixel(const State *state, int x, int y)
+{
+	Point	offset;
+
+	offset.x = -state->radius_real + (x + 0.5) * (2.0 * state->radius_real / state->width);
+	offset.y = -state->radius_imag + (y + 0.5) * (2.0 * state->radius_imag / state->height);
+	return offset;
+}
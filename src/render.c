@@ -0,0 +1,471 @@
+#include "mandel.h"
+#include "config.h"
+
+#define TILE_AREA (MANDEL_TILE_SIZE * MANDEL_TILE_SIZE)
+
+typedef struct s_tile	Tile;
+
+typedef struct
+{
+	State			*state;
+	int				*counts;
+	int				*periods;
+	int				precision;
+	int				tiles_x;
+	double			real_origin;
+	double			imag_origin;
+	double			real_step;
+	double			imag_step;
+	Point			origin;
+	DoubleDouble	center_real;
+	DoubleDouble	center_imag;
+	Fixed128		fixed_real;
+	Fixed128		fixed_imag;
+	unsigned char	*status;
+	RenderStats		*stats;
+	Tile			*tiles;
+}					RenderJob;
+
+/*
+** Pixels already known in the tile being rendered and the buffers
+** to send a batch of them to the kernel, one per worker of the pool
+*/
+
+struct					s_tile
+{
+	RenderJob			*job;
+	const Reference		*reference;
+	int					x_start;
+	int					y_start;
+	int					x_end;
+	int					y_end;
+	bool				known[TILE_AREA];
+	bool				queued[TILE_AREA];
+	int					queue[TILE_AREA];
+	int					queue_count;
+	int					pending[TILE_AREA];
+	int					pending_count;
+	double				re[TILE_AREA];
+	double				im[TILE_AREA];
+	float				re_float[TILE_AREA];
+	float				im_float[TILE_AREA];
+	int					out[TILE_AREA];
+	int					period[TILE_AREA];
+	bool				glitched[TILE_AREA];
+	long				computed;
+	long				filled;
+};
+
+static void	st_render_tile(void *arg, int worker, int task);
+static void	st_brute(Tile *tile);
+static void	st_subdivide(Tile *tile, int x0, int y0, int x1, int y1);
+static bool	st_encloses_origin(const Tile *tile, int x0, int y0, int x1, int y1);
+static void	st_trace(Tile *tile);
+static void	st_trace_scan(Tile *tile, int x, int y);
+static void	st_trace_push(Tile *tile, int x, int y);
+static bool	st_same(Tile *tile, int x, int y, int other_x, int other_y);
+static void	st_fill(Tile *tile, int x, int y, int from_x, int from_y);
+static void	st_queue(Tile *tile, int x, int y);
+static void	st_flush(Tile *tile);
+static int	*st_count(Tile *tile, int x, int y);
+
+/*
+** Fill counts (width * height, row 0 at imag_start) with the escape count
+** of every pixel center, like gl_FragCoord in the shader.
+** MANDEL_TILE_SIZE square tiles are shared by the pool,
+** stats (optional) receives how many pixels were computed and filled.
+** Double-double, fixed point and perturbation work on offsets from the
+** center so their coordinates come from the radii, the perturbation
+** references are prepared first and take their offsets scaled like the
+** radii, a tile
+** iterates against the nearest one (shared by every thread), its glitched
+** pixels are then rendered again against secondary references.
+** PRECISION_AUTO takes the rung of the precision ladder. Float, even
+** when asked for, is only kept while the pixel is wide enough for it
+** (precision_select) and falls back to double past that zoom, fixed
+** point falls back to double-double outside its range (fixed_supported).
+** periods (optional) receives the period of the pixels inside the set, 0
+** when unknown or in the number types without cycle detection (all but
+** double and float), and the pixels take part in the fills only with the
+** period of their neighbors.
+** Returns false, counts left incomplete, when an allocation failed.
+*/
+
+bool		render_cpu(State *state, int *counts, int *periods, RenderStats *stats)
+{
+	RenderJob	job;
+	RenderStats	local;
+	int			tiles_y;
+	int			scale;
+	bool		ok;
+
+	job.state = state;
+	job.counts = counts;
+	job.periods = periods;
+	job.precision = state->precision == PRECISION_AUTO ? precision_select(state) : state->precision;
+	if (job.precision == PRECISION_FLOAT && precision_select(state) != PRECISION_FLOAT)
+		job.precision = PRECISION_DOUBLE;
+	if ((job.precision == PRECISION_FIXED64 || job.precision == PRECISION_FIXED128) && !fixed_supported(state))
+		job.precision = PRECISION_DOUBLE_DOUBLE;
+	job.tiles_x = (state->width + MANDEL_TILE_SIZE - 1) / MANDEL_TILE_SIZE;
+	job.origin = (Point){-1.0, -1.0};
+	if (state->real_start < state->real_end && state->imag_start < state->imag_end)
+		job.origin = (Point){-state->real_start / (state->real_end - state->real_start) * state->width,
+							 -state->imag_start / (state->imag_end - state->imag_start) * state->height};
+	job.status = NULL;
+	if ((job.tiles = malloc(sizeof(Tile) * state->pool.size)) == NULL)
+		return false;
+	if (job.precision != PRECISION_DOUBLE && job.precision != PRECISION_FLOAT)
+	{
+		if (job.precision == PRECISION_PERTURBATION
+			&& (!references_prepare(state)
+				|| (job.status = calloc((size_t)state->width * state->height, 1)) == NULL))
+		{
+			free(job.tiles);
+			return false;
+		}
+		job.center_real = dd_from_big(&state->center_real);
+		job.center_imag = dd_from_big(&state->center_imag);
+		job.fixed_real = fixed_from_big(&state->center_real);
+		job.fixed_imag = fixed_from_big(&state->center_imag);
+		scale = job.precision == PRECISION_PERTURBATION ? 0 : state->radius_exponent;
+		job.real_origin = ldexp(-state->radius_real, scale);
+		job.imag_origin = ldexp(-state->radius_imag, scale);
+		job.real_step = ldexp(2.0 * state->radius_real / state->width, scale);
+		job.imag_step = ldexp(2.0 * state->radius_imag / state->height, scale);
+	}
+	else
+	{
+		job.real_origin = state->real_start;
+		job.imag_origin = state->imag_start;
+		job.real_step = (state->real_end - state->real_start) / state->width;
+		job.imag_step = (state->imag_end - state->imag_start) / state->height;
+	}
+	job.stats = stats != NULL ? stats : &local;
+	memset(job.stats, 0, sizeof(RenderStats));
+	job.stats->precision = job.precision;
+	tiles_y = (state->height + MANDEL_TILE_SIZE - 1) / MANDEL_TILE_SIZE;
+	ok = pool_run(&state->pool, job.tiles_x * tiles_y, st_render_tile, &job);
+	if (ok && job.status != NULL)
+		ok = glitch_correct(state, counts, job.status,
+				(Point){job.real_origin, job.imag_origin},
+				(Point){job.real_step, job.imag_step}, job.stats);
+	free(job.status);
+	free(job.tiles);
+	return ok;
+}
+
+static void	st_render_tile(void *arg, int worker, int task)
+{
+	RenderJob	*job = arg;
+	Tile		*tile = &job->tiles[worker];
+
+	tile->job = job;
+	tile->x_start = (task % job->tiles_x) * MANDEL_TILE_SIZE;
+	tile->y_start = (task / job->tiles_x) * MANDEL_TILE_SIZE;
+	tile->x_end = MIN(tile->x_start + MANDEL_TILE_SIZE, job->state->width);
+	tile->y_end = MIN(tile->y_start + MANDEL_TILE_SIZE, job->state->height);
+	tile->reference = NULL;
+	if (job->precision == PRECISION_PERTURBATION)
+		tile->reference = references_nearest(job->state,
+				(Point){job->real_origin + (tile->x_start + tile->x_end) / 2.0 * job->real_step,
+						job->imag_origin + (tile->y_start + tile->y_end) / 2.0 * job->imag_step});
+	tile->pending_count = 0;
+	tile->queue_count = 0;
+	tile->computed = 0;
+	tile->filled = 0;
+	memset(tile->known, 0, sizeof(tile->known));
+	memset(tile->queued, 0, sizeof(tile->queued));
+
+	if (job->state->render_mode == RENDER_SUBDIVIDE)
+		st_subdivide(tile, tile->x_start, tile->y_start, tile->x_end, tile->y_end);
+	else if (job->state->render_mode == RENDER_TRACE)
+		st_trace(tile);
+	else
+		st_brute(tile);
+
+	__atomic_fetch_add(&job->stats->computed, tile->computed, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&job->stats->filled, tile->filled, __ATOMIC_RELAXED);
+}
+
+static void	st_brute(Tile *tile)
+{
+	for (int y = tile->y_start; y < tile->y_end; y++)
+		for (int x = tile->x_start; x < tile->x_end; x++)
+			st_queue(tile, x, y);
+	st_flush(tile);
+}
+
+/*
+** Mariani-Silver: compute the border of the rectangle [x0, x1) * [y0, y1),
+** the set is connected so a border of a single escape count
+** encloses only that count and the inside is filled without computing it,
+** unless the border is a contour around the whole set: a count below the
+** iterations around c = 0 is subdivided like any other border.
+** Otherwise split in four quadrants sharing their middle row and column.
+*/
+
+static void	st_subdivide(Tile *tile, int x0, int y0, int x1, int y1)
+{
+	int		first;
+	bool	uniform;
+
+	for (int x = x0; x < x1; x++)
+	{
+		st_queue(tile, x, y0);
+		st_queue(tile, x, y1 - 1);
+	}
+	for (int y = y0 + 1; y < y1 - 1; y++)
+	{
+		st_queue(tile, x0, y);
+		st_queue(tile, x1 - 1, y);
+	}
+	st_flush(tile);
+
+	first = *st_count(tile, x0, y0);
+	uniform = true;
+	for (int x = x0; uniform && x < x1; x++)
+		uniform = st_same(tile, x, y0, x0, y0) && st_same(tile, x, y1 - 1, x0, y0);
+	for (int y = y0 + 1; uniform && y < y1 - 1; y++)
+		uniform = st_same(tile, x0, y, x0, y0) && st_same(tile, x1 - 1, y, x0, y0);
+
+	if (uniform && (first == tile->job->state->iterations || !st_encloses_origin(tile, x0, y0, x1, y1)))
+	{
+		for (int y = y0 + 1; y < y1 - 1; y++)
+			for (int x = x0 + 1; x < x1 - 1; x++)
+				st_fill(tile, x, y, x0, y0);
+		return ;
+	}
+	if (x1 - x0 <= MANDEL_SUBDIVIDE_MIN || y1 - y0 <= MANDEL_SUBDIVIDE_MIN)
+	{
+		for (int y = y0 + 1; y < y1 - 1; y++)
+			for (int x = x0 + 1; x < x1 - 1; x++)
+				st_queue(tile, x, y);
+		st_flush(tile);
+		return ;
+	}
+	int	x_mid = (x0 + x1) / 2;
+	int	y_mid = (y0 + y1) / 2;
+	st_subdivide(tile, x0, y0, x_mid + 1, y_mid + 1);
+	st_subdivide(tile, x_mid, y0, x1, y_mid + 1);
+	st_subdivide(tile, x0, y_mid, x_mid + 1, y1);
+	st_subdivide(tile, x_mid, y_mid, x1, y1);
+}
+
+/*
+** Whether c = 0 lies in the rectangle [x0, x1) * [y0, y1) of pixels, the
+** contours around the whole set only show up in such a rectangle
+*/
+
+static bool	st_encloses_origin(const Tile *tile, int x0, int y0, int x1, int y1)
+{
+	Point	origin = tile->job->origin;
+
+	return origin.x >= x0 && origin.x <= x1 && origin.y >= y0 && origin.y <= y1;
+}
+
+/*
+** Boundary tracing: starting from the tile edges, only the pixels on the
+** contour of a region of one escape count are queued and scanned,
+** scanning computes the 4 neighbors and queues those of another count
+** (and the diagonals between them). The untouched pixels are then
+** enclosed by a contour and take the count of their left neighbor.
+** A tile around c = 0 also starts from the row through it, which crosses
+** the contours inside one around the whole set.
+** The queue is processed in waves so the kernel still gets batches.
+*/
+
+static void	st_trace(Tile *tile)
+{
+	int		head = 0;
+
+	for (int x = tile->x_start; x < tile->x_end; x++)
+	{
+		st_trace_push(tile, x, tile->y_start);
+		st_trace_push(tile, x, tile->y_end - 1);
+	}
+	for (int y = tile->y_start + 1; y < tile->y_end - 1; y++)
+	{
+		st_trace_push(tile, tile->x_start, y);
+		st_trace_push(tile, tile->x_end - 1, y);
+	}
+	if (st_encloses_origin(tile, tile->x_start, tile->y_start, tile->x_end, tile->y_end))
+	{
+		int	y = (int)tile->job->origin.y;
+
+		if (y == tile->y_end)
+			y--;
+		for (int x = tile->x_start + 1; x < tile->x_end - 1; x++)
+			st_trace_push(tile, x, y);
+	}
+	while (head < tile->queue_count)
+	{
+		int	wave_end = tile->queue_count;
+
+		for (int i = head; i < wave_end; i++)
+		{
+			int	x = tile->x_start + tile->queue[i] % MANDEL_TILE_SIZE;
+			int	y = tile->y_start + tile->queue[i] / MANDEL_TILE_SIZE;
+
+			st_queue(tile, x, y);
+			if (x > tile->x_start)
+				st_queue(tile, x - 1, y);
+			if (x < tile->x_end - 1)
+				st_queue(tile, x + 1, y);
+			if (y > tile->y_start)
+				st_queue(tile, x, y - 1);
+			if (y < tile->y_end - 1)
+				st_queue(tile, x, y + 1);
+		}
+		st_flush(tile);
+		for (int i = head; i < wave_end; i++)
+			st_trace_scan(tile, tile->x_start + tile->queue[i] % MANDEL_TILE_SIZE,
+							tile->y_start + tile->queue[i] / MANDEL_TILE_SIZE);
+		head = wave_end;
+	}
+	for (int y = tile->y_start; y < tile->y_end; y++)
+		for (int x = tile->x_start + 1; x < tile->x_end; x++)
+			st_fill(tile, x, y, x - 1, y);
+}
+
+static void	st_trace_scan(Tile *tile, int x, int y)
+{
+	bool	has_left = x > tile->x_start;
+	bool	has_right = x < tile->x_end - 1;
+	bool	has_up = y > tile->y_start;
+	bool	has_down = y < tile->y_end - 1;
+	bool	left = has_left && !st_same(tile, x - 1, y, x, y);
+	bool	right = has_right && !st_same(tile, x + 1, y, x, y);
+	bool	up = has_up && !st_same(tile, x, y - 1, x, y);
+	bool	down = has_down && !st_same(tile, x, y + 1, x, y);
+
+	if (left)
+		st_trace_push(tile, x - 1, y);
+	if (right)
+		st_trace_push(tile, x + 1, y);
+	if (up)
+		st_trace_push(tile, x, y - 1);
+	if (down)
+		st_trace_push(tile, x, y + 1);
+	if (has_up && has_left && (up || left))
+		st_trace_push(tile, x - 1, y - 1);
+	if (has_up && has_right && (up || right))
+		st_trace_push(tile, x + 1, y - 1);
+	if (has_down && has_left && (down || left))
+		st_trace_push(tile, x - 1, y + 1);
+	if (has_down && has_right && (down || right))
+		st_trace_push(tile, x + 1, y + 1);
+}
+
+static void	st_trace_push(Tile *tile, int x, int y)
+{
+	int		i = (y - tile->y_start) * MANDEL_TILE_SIZE + x - tile->x_start;
+
+	if (tile->queued[i])
+		return ;
+	tile->queued[i] = true;
+	tile->queue[tile->queue_count++] = i;
+}
+
+/*
+** Same count, and same period when they are kept. Inside the set a pixel
+** whose period is unknown matches none: those ring the components whose
+** period is known, which would be missed by the fills.
+*/
+
+static bool	st_same(Tile *tile, int x, int y, int other_x, int other_y)
+{
+	int		width = tile->job->state->width;
+	int		*periods = tile->job->periods;
+	int		count = *st_count(tile, x, y);
+
+	if (count != *st_count(tile, other_x, other_y) || periods == NULL)
+		return count == *st_count(tile, other_x, other_y);
+	return periods[y * width + x] == periods[other_y * width + other_x]
+		&& (periods[y * width + x] != 0 || count < tile->job->state->iterations);
+}
+
+/*
+** The count and period of another pixel, already known
+*/
+
+static void	st_fill(Tile *tile, int x, int y, int from_x, int from_y)
+{
+	int		width = tile->job->state->width;
+	bool	*known = &tile->known[(y - tile->y_start) * MANDEL_TILE_SIZE + x - tile->x_start];
+
+	if (*known)
+		return ;
+	*known = true;
+	*st_count(tile, x, y) = *st_count(tile, from_x, from_y);
+	if (tile->job->periods != NULL)
+		tile->job->periods[y * width + x] = tile->job->periods[from_y * width + from_x];
+	if (tile->job->status != NULL)
+		tile->job->status[y * tile->job->state->width + x] = PIXEL_FILLED;
+	tile->filled++;
+}
+
+static void	st_queue(Tile *tile, int x, int y)
+{
+	RenderJob	*job = tile->job;
+	bool		*known = &tile->known[(y - tile->y_start) * MANDEL_TILE_SIZE + x - tile->x_start];
+
+	if (*known)
+		return ;
+	*known = true;
+	tile->re[tile->pending_count] = job->real_origin + (x + 0.5) * job->real_step;
+	tile->im[tile->pending_count] = job->imag_origin + (y + 0.5) * job->imag_step;
+	if (tile->reference != NULL)
+	{
+		tile->re[tile->pending_count] -= tile->reference->offset.x;
+		tile->im[tile->pending_count] -= tile->reference->offset.y;
+	}
+	tile->pending[tile->pending_count++] = y * job->state->width + x;
+}
+
+static void	st_flush(Tile *tile)
+{
+	RenderJob	*job = tile->job;
+	State		*state = job->state;
+	int			*period = job->periods != NULL ? tile->period : NULL;
+
+	if (period != NULL)
+		memset(period, 0, sizeof(int) * tile->pending_count);
+	if (job->precision == PRECISION_DOUBLE_DOUBLE)
+		mandelbrot_dd_batch(job->center_real, job->center_imag, tile->re, tile->im, tile->out,
+				tile->pending_count, state->iterations);
+	else if (job->precision == PRECISION_FIXED64 || job->precision == PRECISION_FIXED128)
+		mandelbrot_fixed_batch(job->precision, job->fixed_real, job->fixed_imag, tile->re, tile->im, tile->out,
+				tile->pending_count, state->iterations);
+	else if (job->precision == PRECISION_PERTURBATION)
+		perturbation_batch(tile->reference, tile->re, tile->im, tile->out, tile->glitched,
+				tile->pending_count, state->iterations);
+	else if (job->precision == PRECISION_FLOAT)
+	{
+		for (int i = 0; i < tile->pending_count; i++)
+		{
+			tile->re_float[i] = tile->re[i];
+			tile->im_float[i] = tile->im[i];
+		}
+		mandelbrot_float_batch(tile->re_float, tile->im_float, tile->out, period, tile->pending_count,
+				state->iterations, state->period_tolerance);
+	}
+	else
+		mandelbrot_batch(tile->re, tile->im, tile->out, period, tile->pending_count,
+				state->iterations, state->period_tolerance);
+	for (int i = 0; i < tile->pending_count; i++)
+		job->counts[tile->pending[i]] = tile->out[i];
+	if (period != NULL)
+		for (int i = 0; i < tile->pending_count; i++)
+			job->periods[tile->pending[i]] = period[i];
+	if (job->status != NULL)
+		for (int i = 0; i < tile->pending_count; i++)
+			job->status[tile->pending[i]] = tile->glitched[i] ? PIXEL_GLITCHED : PIXEL_COMPUTED;
+	tile->computed += tile->pending_count;
+	tile->pending_count = 0;
+}
+
+static int	*st_count(Tile *tile, int x, int y)
+{
+	return &tile->job->counts[y * tile->job->state->width + x];
+}
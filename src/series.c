@@ -0,0 +1,108 @@
+#include "mandel.h"
+#include "config.h"
+
+#define PROBES 8
+
+static bool	st_accurate(const Series *series, double ur, double ui, double dzr, double dzi);
+
+/*
+** Series approximation of the delta around the reference orbit:
+** dz_n = A_n dc + B_n dc^2 + C_n dc^3 with
+** A_n+1 = 2 Z_n A_n + 1, B_n+1 = 2 Z_n B_n + A_n^2, C_n+1 = 2 Z_n C_n + 2 A_n B_n.
+** The coefficients are kept scaled by powers of the radius (dc = u * scale)
+** so they do not underflow at deep zooms.
+**
+** The skip is the last iteration where the cubic term is negligible and
+** probes on the corners and edges of the view, iterated exactly next to
+** the series, agree with it within MANDEL_SERIES_TOLERANCE.
+*/
+
+void		series_compute(Series *series, const Orbit *orbit,
+							double radius_real, double radius_imag, int iterations)
+{
+	Series	current;
+	double	probe_ur[PROBES] = {-1, 0, 1, -1, 1, -1, 0, 1};
+	double	probe_ui[PROBES] = {-1, -1, -1, 0, 0, 1, 1, 1};
+	double	probe_dzr[PROBES] = {0};
+	double	probe_dzi[PROBES] = {0};
+	double	u_max;
+
+	memset(&current, 0, sizeof(Series));
+	current.scale = MAX(radius_real, radius_imag);
+	u_max = sqrt(2.0);
+	for (int p = 0; p < PROBES; p++)
+	{
+		probe_ur[p] *= radius_real / current.scale;
+		probe_ui[p] *= radius_imag / current.scale;
+	}
+	*series = current;
+	for (int n = 0; n < iterations && n + 1 < orbit->length; n++)
+	{
+		double	zr = 2.0 * ORBIT_RE(orbit, n);
+		double	zi = 2.0 * ORBIT_IM(orbit, n);
+		Series	next = current;
+
+		next.a_re = zr * current.a_re - zi * current.a_im + current.scale;
+		next.a_im = zr * current.a_im + zi * current.a_re;
+		next.b_re = zr * current.b_re - zi * current.b_im
+			+ current.a_re * current.a_re - current.a_im * current.a_im;
+		next.b_im = zr * current.b_im + zi * current.b_re
+			+ 2.0 * current.a_re * current.a_im;
+		next.c_re = zr * current.c_re - zi * current.c_im
+			+ 2.0 * (current.a_re * current.b_re - current.a_im * current.b_im);
+		next.c_im = zr * current.c_im + zi * current.c_re
+			+ 2.0 * (current.a_re * current.b_im + current.a_im * current.b_re);
+		next.skip = n + 1;
+		if (hypot(next.c_re, next.c_im) * u_max > MANDEL_SERIES_TOLERANCE * hypot(next.b_re, next.b_im))
+			return ;
+		for (int p = 0; p < PROBES; p++)
+		{
+			double	dcr = probe_ur[p] * current.scale;
+			double	dci = probe_ui[p] * current.scale;
+			double	dzr = probe_dzr[p];
+			double	dzi = probe_dzi[p];
+			double	zr_full;
+			double	zi_full;
+
+			probe_dzi[p] = zr * dzi + zi * dzr + 2.0 * dzr * dzi + dci;
+			probe_dzr[p] = zr * dzr - zi * dzi + dzr * dzr - dzi * dzi + dcr;
+			zr_full = ORBIT_RE(orbit, n + 1) + probe_dzr[p];
+			zi_full = ORBIT_IM(orbit, n + 1) + probe_dzi[p];
+			if (zr_full * zr_full + zi_full * zi_full > 4.0
+				|| !st_accurate(&next, probe_ur[p], probe_ui[p], probe_dzr[p], probe_dzi[p]))
+				return ;
+		}
+		current = next;
+		*series = current;
+	}
+}
+
+/*
+** Delta at the skipped iteration for dc = u * scale
+*/
+
+void		series_evaluate(const Series *series, double ur, double ui, double *dzr, double *dzi)
+{
+	double	re = series->c_re;
+	double	im = series->c_im;
+	double	t;
+
+	// Horner: ((C u + B) u + A) u
+	t = re * ur - im * ui + series->b_re;
+	im = re * ui + im * ur + series->b_im;
+	re = t;
+	t = re * ur - im * ui + series->a_re;
+	im = re * ui + im * ur + series->a_im;
+	re = t;
+	*dzr = re * ur - im * ui;
+	*dzi = re * ui + im * ur;
+}
+
+static bool	st_accurate(const Series *series, double ur, double ui, double dzr, double dzi)
+{
+	double	approx_re;
+	double	approx_im;
+
+	series_evaluate(series, ur, ui, &approx_re, &approx_im);
+	return hypot(approx_re - dzr, approx_im - dzi) <= MANDEL_SERIES_TOLERANCE * hypot(dzr, dzi);
+}
@@ -2,27 +2,17 @@
 
 #define MANDEL_SHADER_VERT_FILE "shader/vertex.glsl"
 #define MANDEL_SHADER_FRAG_FILE "shader/fragment.glsl"
+#define MANDEL_SHADER_COUNTS_FILE "shader/counts.glsl"
 
+static unsigned int	st_link(char *vert_filepath, char *frag_filepath);
 static unsigned int	st_compile(char *filepath, unsigned int type);
 static int			st_get_location(unsigned int shader_id, const char *name);
 
 bool				shader_init(Shader *shader)
 {
-	unsigned int	shader_vert;
-	unsigned int	shader_frag;
-
-	if ((shader_vert = st_compile(MANDEL_SHADER_VERT_FILE, GL_VERTEX_SHADER)) == 0
-		|| (shader_frag = st_compile(MANDEL_SHADER_FRAG_FILE, GL_FRAGMENT_SHADER)) == 0)
+	if ((shader->id = st_link(MANDEL_SHADER_VERT_FILE, MANDEL_SHADER_FRAG_FILE)) == 0)
 		return false;
 
-	GL_CALL(shader->id = glCreateProgram());
-	GL_CALL(glAttachShader(shader->id, shader_vert));
-	GL_CALL(glAttachShader(shader->id, shader_frag));
-	GL_CALL(glLinkProgram(shader->id));
-	GL_CALL(glValidateProgram(shader->id));
-	GL_CALL(glDeleteShader(shader_vert));
-	GL_CALL(glDeleteShader(shader_frag));
-
 	if ((shader->location.width = st_get_location(shader->id, "u_width")) == -1
 		|| (shader->location.height = st_get_location(shader->id, "u_height")) == -1
 		|| (shader->location.real_start = st_get_location(shader->id, "u_real_start")) == -1
@@ -32,6 +22,22 @@ bool				shader_init(Shader *shader)
 		|| (shader->location.iterations = st_get_location(shader->id, "u_iterations")) == -1
 		|| (shader->location.smooth = st_get_location(shader->id, "u_smooth")) == -1
 		|| (shader->location.samples = st_get_location(shader->id, "u_samples")) == -1
+		|| (shader->location.period_tolerance = st_get_location(shader->id, "u_period_tolerance")) == -1
+		|| (shader->location.period_color = st_get_location(shader->id, "u_period_color")) == -1
+		|| (shader->location.texture = st_get_location(shader->id, "u_texture")) == -1)
+		return false;
+	return true;
+}
+
+bool				shader_counts_init(CountsShader *shader)
+{
+	if ((shader->id = st_link(MANDEL_SHADER_VERT_FILE, MANDEL_SHADER_COUNTS_FILE)) == 0)
+		return false;
+
+	if ((shader->location.iterations = st_get_location(shader->id, "u_iterations")) == -1
+		|| (shader->location.counts = st_get_location(shader->id, "u_counts")) == -1
+		|| (shader->location.periods = st_get_location(shader->id, "u_periods")) == -1
+		|| (shader->location.period_color = st_get_location(shader->id, "u_period_color")) == -1
 		|| (shader->location.texture = st_get_location(shader->id, "u_texture")) == -1)
 		return false;
 	return true;
@@ -45,8 +51,21 @@ static int			st_get_location(unsigned int shader_id, const char *name)
 	return location;
 }
 
+/*
+** The bounds go to the shader as floats, past the float rung of the
+** precision ladder the image is garbage, which is said once.
+*/
+
 void				shader_set_uniforms(Shader *shader, State *state)
 {
+	static bool	warned = false;
+
+	if (!warned && precision_select(state) != PRECISION_FLOAT)
+	{
+		fprintf(stderr, "[WARNING] float shader past its precision, the view needs %s\n",
+				precision_name(precision_select(state)));
+		warned = true;
+	}
 	GL_CALL(glUniform1i(shader->location.width, state->width));
 	GL_CALL(glUniform1i(shader->location.height, state->height));
 
@@ -61,11 +80,62 @@ void				shader_set_uniforms(Shader *shader, State *state)
 
 	GL_CALL(glUniform1f(shader->location.samples, state->samples));
 
+	GL_CALL(glUniform1f(shader->location.period_tolerance, state->period_tolerance));
+	GL_CALL(glUniform1i(shader->location.period_color, state->period_color));
+
 	GL_CALL(glUniform1i(shader->location.texture, 0));
 	GL_CALL(glActiveTexture(GL_TEXTURE0));
 	GL_CALL(glBindTexture(GL_TEXTURE_1D, state->texture));
 }
 
+/*
+** Counts rendered on the CPU (state->counts, uploaded to
+** state->counts_texture on unit 1) colored with the palette on unit 0,
+** their periods (state->periods) on unit 2 while they are colored
+*/
+
+void				shader_counts_set_uniforms(CountsShader *shader, State *state)
+{
+	GL_CALL(glUniform1i(shader->location.iterations, state->iterations));
+	GL_CALL(glUniform1i(shader->location.period_color, state->period_color));
+
+	GL_CALL(glUniform1i(shader->location.texture, 0));
+	GL_CALL(glActiveTexture(GL_TEXTURE0));
+	GL_CALL(glBindTexture(GL_TEXTURE_1D, state->texture));
+
+	GL_CALL(glUniform1i(shader->location.counts, 1));
+	GL_CALL(glActiveTexture(GL_TEXTURE1));
+	GL_CALL(glBindTexture(GL_TEXTURE_2D, state->counts_texture));
+
+	GL_CALL(glUniform1i(shader->location.periods, 2));
+	GL_CALL(glActiveTexture(GL_TEXTURE2));
+	GL_CALL(glBindTexture(GL_TEXTURE_2D, state->periods_texture));
+}
+
+static unsigned int	st_link(char *vert_filepath, char *frag_filepath)
+{
+	unsigned int	id;
+	unsigned int	shader_vert;
+	unsigned int	shader_frag;
+
+	if ((shader_vert = st_compile(vert_filepath, GL_VERTEX_SHADER)) == 0)
+		return 0;
+	if ((shader_frag = st_compile(frag_filepath, GL_FRAGMENT_SHADER)) == 0)
+	{
+		GL_CALL(glDeleteShader(shader_vert));
+		return 0;
+	}
+
+	GL_CALL(id = glCreateProgram());
+	GL_CALL(glAttachShader(id, shader_vert));
+	GL_CALL(glAttachShader(id, shader_frag));
+	GL_CALL(glLinkProgram(id));
+	GL_CALL(glValidateProgram(id));
+	GL_CALL(glDeleteShader(shader_vert));
+	GL_CALL(glDeleteShader(shader_frag));
+	return id;
+}
+
 static unsigned int	st_compile(char *filepath, unsigned int type)
 {
 	unsigned int	id;
@@ -1,6 +1,9 @@
 #include "config.h"
 #include "mandel.h"
 
+static void	st_draw_gpu(State *state);
+static void	st_draw_cpu(State *state);
+
 bool	state_init(State *state)
 {
     SDL_CALL(SDL_Init(SDL_INIT_VIDEO));
@@ -19,7 +22,7 @@ bool	state_init(State *state)
 	SDL_CALL(state->context = SDL_GL_CreateContext(state->window));
 	assert(glewInit() == GLEW_OK);
 	SDL_CALL(SDL_GL_SetSwapInterval(1));
-	if (!shader_init(&state->shader))
+	if (!shader_init(&state->shader) || !shader_counts_init(&state->counts_shader))
 	{
 		perror(NULL);
 		return false;
@@ -47,6 +50,7 @@ bool	state_init(State *state)
 	GL_CALL(glEnableVertexAttribArray(0));
 
 	state->iterations = MANDEL_ITERATIONS;
+	state->period_tolerance = MANDEL_PERIOD_TOLERANCE;
 	state->texture = color_texture_new(1024);
 	if (state->texture == 0)
 		return false;
@@ -54,25 +58,59 @@ bool	state_init(State *state)
 	state->real_end = 2.0;
 	state->imag_start = -2.0;
 	state->imag_end = 2.0;
+	view_from_bounds(state);
+	state->precision = PRECISION_AUTO;
+	memset(state->references, 0, sizeof(state->references));
+	state->references_count = 0;
+	state->reference_grid = 1;
+	state->render_mode = RENDER_BRUTE;
+	state->rebase = true;
+	state->orbit_float = false;
+	state->orbit_cache.directory = NULL;
+	state->orbit_cache.limit = MANDEL_ORBIT_CACHE_LIMIT;
+
+	GL_CALL(glGenTextures(1, &state->counts_texture));
+	GL_CALL(glBindTexture(GL_TEXTURE_2D, state->counts_texture));
+	GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST));
+	GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
+	GL_CALL(glGenTextures(1, &state->periods_texture));
+	GL_CALL(glBindTexture(GL_TEXTURE_2D, state->periods_texture));
+	GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST));
+	GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
+	state->counts = NULL;
+	state->periods = NULL;
+	state->dirty = true;
 
     state->running = true;
 	state->smooth = false;
+	state->period_color = false;
 	state->samples = 1.0;
+	if (!pool_init(&state->pool, 0))
+		return false;
     return true;
 }
 
+/*
+** Each frame goes through the precision ladder: the float shader while
+** it is accurate, otherwise the CPU renders the counts (again only when
+** the view changed) and they are drawn from a texture.
+*/
+
 void	state_run(State *state)
 {
     while (state->running)
     {
+		int		precision;
+
         event_handle(state);
 		GL_CALL(glClearColor(0.2, 0.3, 0.2, 1.0));
 		GL_CALL(glClear(GL_COLOR_BUFFER_BIT));
 
-		GL_CALL(glUseProgram(state->shader.id));
-		shader_set_uniforms(&state->shader, state);
-		GL_CALL(glBindVertexArray(state->vertex_array));
-		GL_CALL(glDrawArrays(GL_TRIANGLES, 0, 6));
+		precision = state->precision == PRECISION_AUTO ? precision_select(state) : state->precision;
+		if (precision == PRECISION_FLOAT)
+			st_draw_gpu(state);
+		else
+			st_draw_cpu(state);
 
 		SDL_GL_SwapWindow(state->window);
 		SDL_Delay(3);
@@ -81,11 +119,66 @@ void	state_run(State *state)
 
 void	state_quit(State *state)
 {
+	pool_quit(&state->pool);
+	references_free(state);
+	free(state->counts);
+	free(state->periods);
+	GL_CALL(glDeleteTextures(1, &state->counts_texture));
+	GL_CALL(glDeleteTextures(1, &state->periods_texture));
 	GL_CALL(glDeleteTextures(1, &state->texture));
 	GL_CALL(glDeleteBuffers(1, &state->vertex_buf));
 	GL_CALL(glDeleteVertexArrays(1, &state->vertex_array));
 	GL_CALL(glDeleteProgram(state->shader.id));
+	GL_CALL(glDeleteProgram(state->counts_shader.id));
 	SDL_GL_DeleteContext(state->context);
     SDL_DestroyWindow(state->window);
 	SDL_Quit();
 }
+
+static void	st_draw_gpu(State *state)
+{
+	GL_CALL(glUseProgram(state->shader.id));
+	shader_set_uniforms(&state->shader, state);
+	GL_CALL(glBindVertexArray(state->vertex_array));
+	GL_CALL(glDrawArrays(GL_TRIANGLES, 0, 6));
+}
+
+/*
+** The periods are only rendered and uploaded while they are colored
+*/
+
+static void	st_draw_cpu(State *state)
+{
+	int		*counts;
+	int		*periods;
+
+	if (state->dirty || state->counts == NULL)
+	{
+		if ((counts = realloc(state->counts, sizeof(int) * state->width * state->height)) == NULL)
+			return ;
+		state->counts = counts;
+		if (state->period_color)
+		{
+			if ((periods = realloc(state->periods, sizeof(int) * state->width * state->height)) == NULL)
+				return ;
+			state->periods = periods;
+		}
+		if (!render_cpu(state, state->counts, state->period_color ? state->periods : NULL, NULL))
+			return ;
+		GL_CALL(glBindTexture(GL_TEXTURE_2D, state->counts_texture));
+		GL_CALL(glPixelStorei(GL_UNPACK_ALIGNMENT, 4));
+		GL_CALL(glTexImage2D(GL_TEXTURE_2D, 0, GL_R32I, state->width, state->height, 0,
+				GL_RED_INTEGER, GL_INT, state->counts));
+		if (state->period_color)
+		{
+			GL_CALL(glBindTexture(GL_TEXTURE_2D, state->periods_texture));
+			GL_CALL(glTexImage2D(GL_TEXTURE_2D, 0, GL_R32I, state->width, state->height, 0,
+					GL_RED_INTEGER, GL_INT, state->periods));
+		}
+		state->dirty = false;
+	}
+	GL_CALL(glUseProgram(state->counts_shader.id));
+	shader_counts_set_uniforms(&state->counts_shader, state);
+	GL_CALL(glBindVertexArray(state->vertex_array));
+	GL_CALL(glDrawArrays(GL_TRIANGLES, 0, 6));
+}
@@ -0,0 +1,75 @@
+#include "mandel.h"
+#include "config.h"
+
+/*
+** The viewport is kept twice in State: as double bounds for the kernels
+** working on absolute coordinates, and as a high precision center with
+** double radii (half of each span) for the ones working on offsets
+** from the center, which stay exact at any zoom. Past the range of a
+** double the radii are scaled by 2^-radius_exponent.
+*/
+
+void	view_from_bounds(State *state)
+{
+	big_from_double(&state->center_real, (state->real_start + state->real_end) / 2.0);
+	big_from_double(&state->center_imag, (state->imag_start + state->imag_end) / 2.0);
+	state->radius_real = (state->real_end - state->real_start) / 2.0;
+	state->radius_imag = (state->imag_end - state->imag_start) / 2.0;
+	state->radius_exponent = 0;
+}
+
+void	view_to_bounds(State *state)
+{
+	double	center_real = big_to_double(&state->center_real);
+	double	center_imag = big_to_double(&state->center_imag);
+	double	radius_real = ldexp(state->radius_real, state->radius_exponent);
+	double	radius_imag = ldexp(state->radius_imag, state->radius_exponent);
+
+	state->real_start = center_real - radius_real;
+	state->real_end = center_real + radius_real;
+	state->imag_start = center_imag - radius_imag;
+	state->imag_end = center_imag + radius_imag;
+}
+
+/*
+** Radii are scaled back when they cross 2^MANDEL_FLOATEXP_EXPONENT,
+** either way.
+*/
+
+void	view_normalize(State *state)
+{
+	int		exponent = ilogb(state->radius_imag) + state->radius_exponent;
+	int		scale = exponent > MANDEL_FLOATEXP_EXPONENT ? 0 : exponent;
+
+	state->radius_real = ldexp(state->radius_real, state->radius_exponent - scale);
+	state->radius_imag = ldexp(state->radius_imag, state->radius_exponent - scale);
+	state->radius_exponent = scale;
+}
+
+/*
+** The center stays and the radii are multiplied by factor,
+** the bounds follow.
+*/
+
+void	view_zoom(State *state, double factor)
+{
+	state->radius_real *= factor;
+	state->radius_imag *= factor;
+	view_normalize(state);
+	view_to_bounds(state);
+}
+
+/*
+** The center moves by real and imag times the radii, in full precision
+*/
+
+void	view_move(State *state, double real, double imag)
+{
+	Big		shift;
+
+	big_from_floatexp(&shift, fe_make(real * state->radius_real, state->radius_exponent));
+	big_add(&state->center_real, &state->center_real, &shift);
+	big_from_floatexp(&shift, fe_make(imag * state->radius_imag, state->radius_exponent));
+	big_add(&state->center_imag, &state->center_imag, &shift);
+	view_to_bounds(state);
+}